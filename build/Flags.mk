@@ -20,7 +20,6 @@ ESCARGOT_LDFLAGS_COMMON += -lrt
 # flags for $(HOST) : linux / tizen*
 #######################################################
 ESCARGOT_CXXFLAGS_LINUX += -DENABLE_CODECACHE
-# ESCARGOT_CXXFLAGS_LINUX += -DENABLE_DTOACACHE
 
 ESCARGOT_CXXFLAGS_TIZEN += -DESCARGOT_SMALL_CONFIG=1 -DESCARGOT_TIZEN
 
@@ -25,13 +25,14 @@ automake --add-missing
 
 # Common flags --------------------------------------------
 
-GCCONFFLAGS_COMMON=" --disable-parallel-mark " # --enable-large-config --enable-cplusplus"
+GCCONFFLAGS_COMMON=" --enable-threads=posix --enable-parallel-mark " # --enable-large-config --enable-cplusplus"
 CFLAGS_COMMON=" -g3 "
 LDFLAGS_COMMON=
 
 # HOST flags : linux / wearable / mobile / tv -------------
 
-GCCONFFLAGS_wearable=
+# single or dual core devices: marker threads would only add synchronization
+GCCONFFLAGS_wearable=" --disable-parallel-mark "
 CFLAGS_wearable=" -Os "
 LDFLAGS_wearable=
 
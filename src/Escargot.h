@@ -39,6 +39,7 @@
 #include <clocale>
 #include <cwchar>
 #include <climits>
+#include <atomic>
 
 // icu
 #include <unicode/locid.h>
@@ -415,8 +416,9 @@ inline bool operator!=(const gc_malloc_allocator<GC_T1>&, const gc_malloc_alloca
 
 namespace escargot {
 
-typedef std::basic_string<char16_t, std::char_traits<char16_t>, gc_allocator<char16_t> > UTF16String;
-typedef std::basic_string<char, std::char_traits<char>, gc_allocator<char> > ASCIIString;
+// character buffers hold no pointers, so the collector does not need to scan them
+typedef std::basic_string<char16_t, std::char_traits<char16_t>, pointer_free_allocator<char16_t> > UTF16String;
+typedef std::basic_string<char, std::char_traits<char>, pointer_free_allocator<char> > ASCIIString;
 
 namespace options {
 
@@ -435,8 +437,16 @@ static const size_t MaxStackDepth = 5 * MB;
 static const size_t NativeHeapUsageThreshold = 300 * MB;
 #endif
 static const size_t AllocaOnHeapThreshold = 32 * MB;
+// ArrayBuffer contents below the first stay in the collector heap, where they need no
+// finalizer; from the second on they are mapped, so the kernel hands them out zeroed
+static const size_t ArrayBufferMallocThreshold = 1 * KB;
+static const size_t ArrayBufferMmapThreshold = 64 * KB;
 static const size_t MaximumArgumentCount = 65535;
 static const size_t MaximumStringLength = (1 * GB) | 1;
+// must be a power of two
+static const size_t NumberToStringCacheSize = 256;
+// compiled regexps kept by ESVMInstance::m_regexpCache (least recently used ones are evicted beyond this)
+static const size_t RegExpCacheSizeThreshold = 4 * MB;
 static const int64_t MaximumDatePrimitiveValue = 8640000000000000;
 
 }
@@ -42,7 +42,7 @@ public:
         m_left->generateResolveAddressByteCode(codeBlock, context);
         m_left->generateReferenceResolvedAddressByteCode(codeBlock, context);
         m_right->generateExpressionByteCode(codeBlock, context);
-        codeBlock->pushCode(Plus(), context, this);
+        codeBlock->pushCode(AppendingPlus(), context, this);
         m_left->generatePutByteCode(codeBlock, context);
     }
 
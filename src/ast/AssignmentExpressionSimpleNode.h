@@ -20,6 +20,7 @@
 #include "ExpressionNode.h"
 #include "PatternNode.h"
 #include "IdentifierNode.h"
+#include "BinaryExpressionPlusNode.h"
 // #include "MemberExpressionNode.h"
 
 namespace escargot {
@@ -41,10 +42,26 @@ public:
     virtual void generateExpressionByteCode(CodeBlock* codeBlock, ByteCodeGenerateContext& context)
     {
         m_left->generateResolveAddressByteCode(codeBlock, context);
-        m_right->generateExpressionByteCode(codeBlock, context);
+        if (isAppendingPlus()) {
+            // a = a + b
+            BinaryExpressionPlusNode* plus = (BinaryExpressionPlusNode*)m_right;
+            plus->m_left->generateExpressionByteCode(codeBlock, context);
+            plus->m_right->generateExpressionByteCode(codeBlock, context);
+            codeBlock->pushCode(AppendingPlus(), context, plus);
+        } else {
+            m_right->generateExpressionByteCode(codeBlock, context);
+        }
         m_left->generatePutByteCode(codeBlock, context);
     }
 
+    bool isAppendingPlus()
+    {
+        if (!m_left->isIdentifier() || m_right->type() != NodeType::BinaryExpressionPlus)
+            return false;
+        Node* plusLeft = ((BinaryExpressionPlusNode*)m_right)->m_left;
+        return plusLeft->isIdentifier() && ((IdentifierNode*)plusLeft)->name() == ((IdentifierNode*)m_left)->name();
+    }
+
     virtual void computeRoughCodeBlockSizeInWordSize(size_t& result)
     {
         m_left->computeRoughCodeBlockSizeInWordSize(result);
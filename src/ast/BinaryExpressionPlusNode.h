@@ -23,6 +23,7 @@ namespace escargot {
 
 class BinaryExpressionPlusNode : public ExpressionNode {
 public:
+    friend class AssignmentExpressionSimpleNode;
     BinaryExpressionPlusNode(Node *left, Node* right)
         : ExpressionNode(NodeType::BinaryExpressionPlus)
     {
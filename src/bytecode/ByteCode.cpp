@@ -23,8 +23,11 @@
 
 namespace escargot {
 
+size_t CodeBlock::m_allocationCount = 0;
+
 CodeBlock::CodeBlock(ExecutableType type, size_t roughCodeBlockSizeInWordSize, bool isBuiltInFunction)
 {
+    m_allocationCount++;
     m_type = type;
     m_ast = NULL;
     if (roughCodeBlockSizeInWordSize)
@@ -56,15 +59,21 @@ CodeBlock::CodeBlock(ExecutableType type, size_t roughCodeBlockSizeInWordSize, b
 #endif
 
     ESVMInstance* instance = ESVMInstance::currentInstance();
+#if defined(ENABLE_ESJIT) || !defined(NDEBUG)
+    // the extra data and the JIT code live in the malloc heap
     GC_REGISTER_FINALIZER_NO_ORDER(this, [] (void* obj, void* cd) {
         ((CodeBlock *)obj)->finalize((ESVMInstance*)cd, true);
     }, instance, NULL, NULL);
+#endif
+    m_registryEntry = NULL;
     instance->globalObject()->registerCodeBlock(this);
 }
 
 void CodeBlock::finalize(ESVMInstance* instance, bool unregisterCodeBlockNow)
 {
+#if defined(ENABLE_ESJIT) || !defined(NDEBUG)
     GC_REGISTER_FINALIZER_NO_ORDER(this, NULL, NULL, NULL, NULL);
+#endif
 
     if (unregisterCodeBlockNow)
         instance->globalObject()->unregisterCodeBlock(this);
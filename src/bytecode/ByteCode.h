@@ -82,6 +82,7 @@ class CodeBlock;
     F(GreaterThan, 1, 2, 0, 1, 0) \
     F(GreaterThanOrEqual, 1, 2, 0, 1, 0) \
     F(Plus, 1, 2, 0, 1, 0) \
+    F(AppendingPlus, 1, 2, 0, 1, 0) \
     F(Minus, 1, 2, 0, 1, 0) \
     F(Multiply, 1, 2, 0, 1, 0) \
     F(Division, 1, 2, 0, 1, 0) \
@@ -1138,6 +1139,23 @@ public:
 #endif
 };
 
+// Plus whose result is stored back to its left operand (s += x, s = s + x)
+// so string results can grow the left string in place
+class AppendingPlus : public ByteCode {
+public:
+    AppendingPlus()
+        : ByteCode(AppendingPlusOpcode)
+    {
+    }
+
+#ifndef NDEBUG
+    virtual void dump()
+    {
+        ESCARGOT_LOG_INFO("AppendingPlus <>\n");
+    }
+#endif
+};
+
 class Minus : public ByteCode {
 public:
     Minus()
@@ -2311,6 +2329,11 @@ private:
 public:
     void finalize(ESVMInstance* instance, bool unregisterCodeBlockNow);
 
+    // code blocks created so far
+    static size_t m_allocationCount;
+    // owned by GlobalObject, see registerCodeBlock
+    CodeBlockRegistryEntry* m_registryEntry;
+
     template <typename CodeType>
     void pushCode(const CodeType& type, ByteCodeGenerateContext& context, Node* node);
     inline void pushCode(const ExecuteNativeFunction& code);
@@ -487,6 +487,15 @@ ESValue interpret(ESVMInstance* instance, CodeBlock* codeBlock, size_t programCo
             NEXT_INSTRUCTION();
         }
 
+        AppendingPlusOpcodeLbl:
+        {
+            ESValue* right = POP(stack, bp);
+            ESValue* left = POP(stack, bp);
+            PUSH(stack, topOfStack, plusOperation(left, right, true));
+            executeNextCode<AppendingPlus>(programCounter);
+            NEXT_INSTRUCTION();
+        }
+
         MinusOpcodeLbl:
         {
             ESValue* right = POP(stack, bp);
@@ -123,7 +123,7 @@ NEVER_INLINE void setByGlobalIndexOperationSlowCase(GlobalObject* globalObject,
 }
 
 
-NEVER_INLINE ESValue plusOperationSlowCase(ESValue* left, ESValue* right)
+NEVER_INLINE ESValue plusOperationSlowCase(ESValue* left, ESValue* right, bool isAppending)
 {
     ESValue ret(ESValue::ESForceUninitialized);
     ESValue lval(ESValue::ESForceUninitialized);
@@ -147,7 +147,10 @@ NEVER_INLINE ESValue plusOperationSlowCase(ESValue* left, ESValue* right)
     }
 
     if (lval.isESString() || rval.isESString()) {
-        ret = ESString::concatTwoStrings(lval.toString(), rval.toString());
+        if (isAppending)
+            ret = ESString::appendTwoStrings(lval.toString(), rval.toString());
+        else
+            ret = ESString::concatTwoStrings(lval.toString(), rval.toString());
     } else {
         ret = ESValue(lval.toNumber() + rval.toNumber());
     }
@@ -110,8 +110,8 @@ NEVER_INLINE void setByGlobalIndexOperationWithNoInline(GlobalObject* globalObje
 
 NEVER_INLINE ESValue getByIdOperationWithNoInline(ESVMInstance* instance, ExecutionContext* ec, GetById* code);
 
-NEVER_INLINE ESValue plusOperationSlowCase(ESValue* left, ESValue* right);
-ALWAYS_INLINE ESValue plusOperation(ESValue* left, ESValue* right)
+NEVER_INLINE ESValue plusOperationSlowCase(ESValue* left, ESValue* right, bool isAppending);
+ALWAYS_INLINE ESValue plusOperation(ESValue* left, ESValue* right, bool isAppending = false)
 {
     ESValue ret(ESValue::ESForceUninitialized);
     if (left->isInt32() && right->isInt32()) {
@@ -129,7 +129,7 @@ ALWAYS_INLINE ESValue plusOperation(ESValue* left, ESValue* right)
         ret = ESValue(left->asNumber() + right->asNumber());
         return ret;
     } else {
-        return plusOperationSlowCase(left, right);
+        return plusOperationSlowCase(left, right, isAppending);
     }
 
 }
@@ -211,8 +211,8 @@ ALWAYS_INLINE ESValue getObjectOperation(ESValue* willBeObject, ESValue* propert
 #ifdef USE_ES6_FEATURE
         } else if (ptr->isESTypedArrayObject()) {
             uint32_t idx = property->toIndex();
-            ESTypedArrayObjectWrapper* arr =ptr->asESTypedArrayObjectWrapper();
-            return arr->get(idx);
+            if (LIKELY(idx != ESValue::ESInvalidIndexValue))
+                return ptr->asESTypedArrayObjectWrapper()->get(idx);
 #endif
         } else if (ptr->isESString()) {
             uint32_t idx = property->toIndex();
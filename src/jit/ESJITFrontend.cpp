@@ -391,6 +391,14 @@ ESGraph* generateIRFromByteCode(CodeBlock* codeBlock)
                 NEXT_BYTECODE(Plus);
                 break;
             }
+        case AppendingPlusOpcode:
+            {
+                INIT_BYTECODE(AppendingPlus);
+                ESIR* genericPlusIR = GenericPlusIR::create(extraData->m_decoupledData->m_targetIndex0, extraData->m_decoupledData->m_sourceIndexes[0], extraData->m_decoupledData->m_sourceIndexes[1]);
+                currentBlock->push(genericPlusIR);
+                NEXT_BYTECODE(AppendingPlus);
+                break;
+            }
         case MinusOpcode:
             {
                 INIT_BYTECODE(Minus);
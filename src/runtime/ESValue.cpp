@@ -35,10 +35,14 @@
 #include "bytecode/ByteCodeOperations.h"
 
 #include "Yarr.h"
+#include "runtime/RegExpMatcher.h"
+#include "runtime/RegExpPrefilter.h"
 
 #include "fast-dtoa.h"
 #include "bignum-dtoa.h"
 
+#include <sys/mman.h>
+
 namespace escargot {
 
 const char* errorMessage_DefineProperty_Default = "Cannot define property '%s'";
@@ -64,6 +68,20 @@ NEVER_INLINE bool reject(bool throwFlag, ESErrorObject::Code code, const char* t
     return false;
 }
 
+size_t ESPointer::m_allocationCount[ESPointer::TotalNumberOfTypes];
+
+const char* ESPointer::typeName(size_t typeIndex)
+{
+    // in the order of ESPointer::Type
+    static const char* names[TotalNumberOfTypes] = {
+        "String", "RopeString", "Object", "Function", "Array", "StringObject", "Error", "Date",
+        "Number", "RegExp", "Math", "Boolean", "ArrayBuffer", "ArrayBufferView", "TypedArray",
+        "DataView", "Promise", "Arguments", "ControlFlowRecord", "JSON"
+    };
+    ASSERT(typeIndex < TotalNumberOfTypes);
+    return names[typeIndex];
+}
+
 ESHiddenClassPropertyInfo ESHiddenClassPropertyInfo::s_dummyPropertyInfo(nullptr, Data | PropertyDescriptor::defaultAttributes);
 ESHiddenClassPropertyInfo::ESHiddenClassPropertyInfo()
 {
@@ -506,51 +524,101 @@ ESString* ESString::substring(int from, int to) const
     }
 }
 
-size_t ESString::createRegexMatchResult(escargot::ESRegExpObject* regexp, RegexMatchResult& result)
-{
-    size_t len = 0, previousLastIndex = 0;
-    bool testResult;
-    RegexMatchResult temp;
-    temp.m_matchResults.push_back(result.m_matchResults[0]);
-    result.m_matchResults.clear();
-    do {
-        const size_t maximumReasonableMatchSize = 1000000000;
-        if (len > maximumReasonableMatchSize) {
-            ESVMInstance::currentInstance()->throwError(RangeError::create(ESString::create("Maximum Reasonable match size exceeded.")));
-        }
+// visits the flat pieces of a string from left to right
+// rope trees deeper than MaxDepth are not walked; compareSlowCase flattens them instead
+class ESStringPieceCursor {
+public:
+    static const size_t MaxDepth = 32;
 
-        if (regexp->lastIndex().toIndex() == previousLastIndex) {
-            regexp->set(strings->lastIndex.string(), ESValue(previousLastIndex++), true);
-        } else {
-            previousLastIndex = regexp->lastIndex().toIndex();
-        }
+    ESStringPieceCursor(const ESString* str)
+        : m_piece(NULL)
+        , m_offset(0)
+        , m_overflowed(false)
+        , m_depth(0)
+    {
+        m_stack[m_depth++] = str;
+        m_overflowed = !nextPiece();
+    }
 
-        // FIXME: I am not sure when m_matchResults[i][0].m_start returned with max
-        size_t end = temp.m_matchResults[0][0].m_end;
-        size_t length = end - temp.m_matchResults[0][0].m_start;
-        if (!length) {
-            ++end;
+    // returns false when the rope is too deep
+    bool nextPiece()
+    {
+        while (m_depth) {
+            const ESString* cur = m_stack[--m_depth];
+            if (cur->isESRopeString()) {
+                ESRopeString* rope = (ESRopeString*)cur;
+                if (!rope->m_content && !rope->m_appendBuffer) {
+                    if (m_depth + 2 > MaxDepth)
+                        return false;
+                    m_stack[m_depth++] = rope->m_right;
+                    m_stack[m_depth++] = rope->m_left;
+                    continue;
+                }
+                cur = rope->string();
+            }
+            if (!cur->length())
+                continue;
+            m_piece = cur;
+            m_offset = 0;
+            return true;
         }
+        m_piece = NULL;
+        return true;
+    }
 
-        result.m_matchResults.insert(result.m_matchResults.end(), temp.m_matchResults.begin(), temp.m_matchResults.end());
-        len++;
-        temp.m_matchResults.clear();
-        testResult = regexp->matchNonGlobally(this, temp, false, end);
-    } while (testResult);
+    const ESString* m_piece;
+    size_t m_offset;
+    bool m_overflowed;
 
-    return len;
+private:
+    const ESString* m_stack[MaxDepth];
+    size_t m_depth;
+};
+
+static size_t pieceMismatch(const ESString* a, size_t offsetA, const ESString* b, size_t offsetB, size_t len)
+{
+    bool aa = a->isASCIIString();
+    bool bb = b->isASCIIString();
+    if (aa && bb)
+        return stringMismatch(a->uncheckedAsASCIIString()->data() + offsetA, b->uncheckedAsASCIIString()->data() + offsetB, len);
+    else if (aa && !bb)
+        return stringMismatch(a->uncheckedAsASCIIString()->data() + offsetA, b->uncheckedAsUTF16String()->data() + offsetB, len);
+    else if (!aa && bb)
+        return stringMismatch(a->uncheckedAsUTF16String()->data() + offsetA, b->uncheckedAsASCIIString()->data() + offsetB, len);
+    return stringMismatch(a->uncheckedAsUTF16String()->data() + offsetA, b->uncheckedAsUTF16String()->data() + offsetB, len);
 }
 
-ESArrayObject* ESString::createMatchedArray(escargot::ESRegExpObject* regexp, RegexMatchResult& result)
+int ESString::compareSlowCase(const ESString& a, const ESString& b)
 {
-    escargot::ESArrayObject* ret = ESArrayObject::create();
-    size_t len = createRegexMatchResult(regexp, result);
-    ret->create(len);
-    for (size_t idx = 0; idx < len; idx++) {
-        ret->defineDataProperty(ESValue(idx), true, true, true, substring(result.m_matchResults[idx][0].m_start, result.m_matchResults[idx][0].m_end));
-    }
+    ESStringPieceCursor cursorA(&a);
+    ESStringPieceCursor cursorB(&b);
+    while (!cursorA.m_overflowed && !cursorB.m_overflowed) {
+        if (!cursorA.m_piece || !cursorB.m_piece) {
+            size_t lenA = a.length();
+            size_t lenB = b.length();
+            if (lenA == lenB)
+                return 0;
+            return lenA > lenB ? 1 : -1;
+        }
 
-    return ret;
+        size_t remainA = cursorA.m_piece->length() - cursorA.m_offset;
+        size_t remainB = cursorB.m_piece->length() - cursorB.m_offset;
+        size_t len = std::min(remainA, remainB);
+        size_t pos = pieceMismatch(cursorA.m_piece, cursorA.m_offset, cursorB.m_piece, cursorB.m_offset, len);
+        if (pos < len) {
+            char16_t ca = cursorA.m_piece->charAt(cursorA.m_offset + pos);
+            char16_t cb = cursorB.m_piece->charAt(cursorB.m_offset + pos);
+            return ca > cb ? 1 : -1;
+        }
+
+        cursorA.m_offset += len;
+        cursorB.m_offset += len;
+        if (cursorA.m_offset == cursorA.m_piece->length())
+            cursorA.m_overflowed = !cursorA.nextPiece();
+        if (cursorB.m_offset == cursorB.m_piece->length())
+            cursorB.m_overflowed = !cursorB.nextPiece();
+    }
+    return stringCompare(*a.unwrap(), *b.unwrap());
 }
 
 ESRopeString* ESRopeString::createAndConcat(ESString* lstr, ESString* rstr)
@@ -583,6 +651,55 @@ ESRopeString* ESRopeString::createAndConcat(ESString* lstr, ESString* rstr)
     return rope;
 }
 
+void ESStringAppendBuffer::append(ESString* str)
+{
+    str = str->unwrap();
+    size_t len = str->length();
+    if (m_isASCIIString) {
+        if (str->isASCIIString()) {
+            const char* src = str->asciiData();
+            m_asciiBuffer.insert(m_asciiBuffer.end(), src, src + len);
+            return;
+        }
+        m_utf16Buffer.resize(m_asciiBuffer.size());
+        widenASCII(m_asciiBuffer.data(), m_asciiBuffer.size(), m_utf16Buffer.data());
+        std::vector<char, pointer_free_allocator<char> >().swap(m_asciiBuffer);
+        m_isASCIIString = false;
+    }
+
+    size_t oldLength = m_utf16Buffer.size();
+    if (str->isASCIIString()) {
+        m_utf16Buffer.resize(oldLength + len);
+        widenASCII(str->asciiData(), len, m_utf16Buffer.data() + oldLength);
+    } else {
+        const char16_t* src = str->utf16Data();
+        m_utf16Buffer.insert(m_utf16Buffer.end(), src, src + len);
+    }
+}
+
+ESRopeString* ESRopeString::createAndAppend(ESRopeString* lstr, ESString* rstr)
+{
+    size_t llen = lstr->length();
+    size_t rlen = rstr->length();
+
+    if (static_cast<int64_t>(llen) > static_cast<int64_t>(ESString::maxLength() - rlen))
+        ESVMInstance::currentInstance()->throwOOMError();
+
+    ESStringAppendBuffer* buffer = lstr->m_appendBuffer;
+    // lstr must cover the whole buffer to grow it. otherwise start over with a copy
+    if (!buffer || buffer->length() != llen) {
+        buffer = new ESStringAppendBuffer();
+        buffer->append(lstr);
+    }
+    buffer->append(rstr);
+
+    ESRopeString* rope = ESRopeString::create();
+    rope->m_contentLength = llen + rlen;
+    rope->m_appendBuffer = buffer;
+    rope->m_hasNonASCIIString = !buffer->m_isASCIIString;
+    return rope;
+}
+
 unsigned PropertyDescriptor::defaultAttributes = Configurable | Enumerable | Writable;
 
 PropertyDescriptor::PropertyDescriptor(ESObject* obj)
@@ -751,7 +868,12 @@ ESValue PropertyDescriptor::fromPropertyDescriptor(ESObject* descSrc, ESString*
         ESValue setStr = strings->set.string();
         obj->defineOwnProperty(setStr, setDesc, false);
     } else {
-        obj->set(strings->value.string(), descSrc->hiddenClass()->read(descSrc, descSrc, propertyName, idx));
+        ESValue value = descSrc->hiddenClass()->read(descSrc, descSrc, propertyName, idx);
+        // the getters of the lazy builtins of the global object redefine the property
+        size_t newIdx = descSrc->hiddenClass()->findProperty(propertyName);
+        if (UNLIKELY(newIdx != idx))
+            return fromPropertyDescriptor(descSrc, propertyName, newIdx);
+        obj->set(strings->value.string(), value);
         descSrc->accessorData(idx)->setGetterAndSetterTo(obj, &propertyInfo);
     }
     obj->set(strings->enumerable.string(), ESValue(propertyInfo.enumerable()));
@@ -1513,6 +1635,8 @@ ESRegExpObject::ESRegExpObject(escargot::ESString* source, const Option& option)
     m_option = option;
     m_yarrPattern = NULL;
     m_bytecodePattern = NULL;
+    m_matcher = NULL;
+    m_prefilter = NULL;
     m_lastIndex = ESValue(0);
     m_lastExecutedString = NULL;
 
@@ -1537,6 +1661,8 @@ void ESRegExpObject::setSource(escargot::ESString* src)
     m_source = escapedSrc;
     m_yarrPattern = entry.m_yarrPattern;
     m_bytecodePattern = entry.m_bytecodePattern;
+    m_matcher = entry.m_matcher;
+    m_prefilter = entry.m_prefilter;
 }
 
 void ESRegExpObject::setOption(const Option& option)
@@ -1546,23 +1672,67 @@ void ESRegExpObject::setOption(const Option& option)
         ) {
         ASSERT(!m_yarrPattern);
         m_bytecodePattern = NULL;
+        m_matcher = NULL;
+        m_prefilter = NULL;
     }
     m_option = option;
 }
 
+// Yarr keeps its vectors on the counted native heap; a collection in between may free
+// other patterns, so the difference is only an estimate
+static size_t nativeHeapGrowthSince(ESVMInstance* instance, size_t usageBefore)
+{
+    size_t usage = instance->nativeHeapUsage();
+    return usage > usageBefore ? usage - usageBefore : 0;
+}
+
 ESRegExpObject::RegExpCacheEntry& ESRegExpObject::getCacheEntryAndCompileIfNeeded(escargot::ESString* source, const Option& option)
 {
-    auto cache = ESVMInstance::currentInstance()->regexpCache();
+    ESVMInstance* instance = ESVMInstance::currentInstance();
+    auto cache = instance->regexpCache();
     auto it = cache->find(RegExpCacheKey(source, option));
     if (it != cache->end()) {
+        instance->m_regexpCacheHitCount++;
+        instance->touchRegExpCacheEntry(it->second);
         return it->second;
     } else {
+        size_t usageBefore = instance->nativeHeapUsage();
         const char* yarrError = nullptr;
         auto yarrPattern = new JSC::Yarr::YarrPattern(*source, option & ESRegExpObject::Option::IgnoreCase, option & ESRegExpObject::Option::MultiLine, &yarrError);
-        return cache->insert(std::make_pair(RegExpCacheKey(source, option), RegExpCacheEntry(yarrError, yarrPattern))).first->second;
+        RegExpCacheEntry& entry = cache->insert(std::make_pair(RegExpCacheKey(source, option), RegExpCacheEntry(yarrError, yarrPattern))).first->second;
+        instance->m_regexpCacheLRU.push_front(RegExpCacheKey(source, option));
+        entry.m_lruPosition = instance->m_regexpCacheLRU.begin();
+        instance->addRegExpCacheBytes(entry, sizeof(JSC::Yarr::YarrPattern) + nativeHeapGrowthSince(instance, usageBefore));
+        return entry;
     }
 }
 
+void ESVMInstance::addRegExpCacheBytes(ESRegExpObject::RegExpCacheEntry& entry, size_t bytes)
+{
+    ASSERT(&m_regexpCache.find(m_regexpCacheLRU.front())->second == &entry);
+    entry.m_bytes += bytes;
+    m_regexpCacheBytes += bytes;
+    while (m_regexpCacheBytes > options::RegExpCacheSizeThreshold && m_regexpCacheLRU.size() > 1) {
+        auto it = m_regexpCache.find(m_regexpCacheLRU.back());
+        ASSERT(it != m_regexpCache.end());
+        m_regexpCacheBytes -= it->second.m_bytes;
+        m_regexpCache.erase(it);
+        m_regexpCacheLRU.pop_back();
+        m_regexpCacheEvictedCount++;
+    }
+}
+
+RegExpCacheStatistics ESVMInstance::regexpCacheStatistics()
+{
+    RegExpCacheStatistics stat;
+    stat.m_entryCount = m_regexpCache.size();
+    stat.m_bytes = m_regexpCacheBytes;
+    stat.m_compileCount = m_regexpCacheCompileCount;
+    stat.m_hitCount = m_regexpCacheHitCount;
+    stat.m_evictedCount = m_regexpCacheEvictedCount;
+    return stat;
+}
+
 ESRegExpObject::Option ESRegExpObject::parseOption(escargot::ESString* optionString)
 {
     ESRegExpObject::Option option = ESRegExpObject::Option::None;
@@ -1599,26 +1769,131 @@ ESRegExpObject::Option ESRegExpObject::parseOption(escargot::ESString* optionStr
     return option;
 }
 
-bool ESRegExpObject::match(const escargot::ESString* str, RegexMatchResult& matchResult, bool testOnly, size_t startIndex)
+template <typename CharType>
+static void reportRegExpMatcherMismatch(const escargot::ESString* source, JSC::Yarr::BytecodePattern* bytecodePattern, const CharType* chars, unsigned length, unsigned start, unsigned* expected, unsigned* actual)
 {
-    m_lastExecutedString = str;
+    unsigned subPatternNum = bytecodePattern->m_body->m_numSubpatterns;
+    fprintf(stderr, "RegExpMatcher differs from the interpreter on /%s/%s%s\n", source->utf8Data(), bytecodePattern->m_ignoreCase ? "i" : "", bytecodePattern->m_multiline ? "m" : "");
+    fprintf(stderr, "  input (length %u, start %u): \"", length, start);
+    for (unsigned i = 0; i < length && i < 64; i ++) {
+        unsigned c = (typename std::make_unsigned<CharType>::type)chars[i];
+        if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\')
+            fputc(c, stderr);
+        else
+            fprintf(stderr, "\\u%04x", c);
+    }
+    fprintf(stderr, "%s\"\n", length > 64 ? "..." : "");
+    for (unsigned i = 0; i < subPatternNum + 1; i ++) {
+        fprintf(stderr, "  $%u interpreter [%d, %d] matcher [%d, %d]\n", i, (int)expected[i * 2], (int)expected[i * 2 + 1], (int)actual[i * 2], (int)actual[i * 2 + 1]);
+    }
+    RELEASE_ASSERT_NOT_REACHED();
+}
+
+template <typename CharType>
+static unsigned matchRegExp(const escargot::ESString* source, JSC::Yarr::BytecodePattern* bytecodePattern, RegExpMatcher* matcher, RegExpPrefilter* prefilter, const CharType* chars, unsigned length, unsigned start, unsigned* outputBuf)
+{
+    typedef typename std::conditional<std::is_same<CharType, char>::value, char, UChar>::type YarrCharType;
+    ESVMInstance* instance = ESVMInstance::currentInstance();
+    if (instance->m_useRegExpInterpreter)
+        return JSC::Yarr::interpret(bytecodePattern, (const YarrCharType*)chars, length, start, outputBuf);
+
+    if (prefilter && prefilter->isLiteral()) {
+        prefilter->matchLiteral(chars, length, start, outputBuf);
+    } else if (matcher) {
+        RegExpMatcher::MatchResult result = matcher->match(chars, length, start, outputBuf);
+        if (result == RegExpMatcher::NeedsInterpreter)
+            return JSC::Yarr::interpret(bytecodePattern, (const YarrCharType*)chars, length, start, outputBuf);
+    } else {
+        // the interpreter scans on by itself, so only the first candidate can be skipped to
+        size_t candidate = prefilter ? prefilter->findCandidate(chars, length, start) : start;
+        if (candidate == SIZE_MAX)
+            return JSC::Yarr::offsetNoMatch;
+        unsigned result = JSC::Yarr::interpret(bytecodePattern, (const YarrCharType*)chars, length, candidate, outputBuf);
+        if (!instance->m_verifyRegExpMatcher || candidate == start)
+            return result;
+    }
 
+    if (UNLIKELY(instance->m_verifyRegExpMatcher)) {
+        size_t outputSize = 2 * (bytecodePattern->m_body->m_numSubpatterns + 1);
+        std::vector<unsigned> expected(outputSize, JSC::Yarr::offsetNoMatch);
+        JSC::Yarr::interpret(bytecodePattern, (const YarrCharType*)chars, length, start, expected.data());
+        // the interpreter may leave captures behind when there is no match
+        bool same = expected[0] == JSC::Yarr::offsetNoMatch ? outputBuf[0] == JSC::Yarr::offsetNoMatch : !memcmp(expected.data(), outputBuf, sizeof(unsigned) * outputSize);
+        if (!same)
+            reportRegExpMatcherMismatch(source, bytecodePattern, chars, length, start, expected.data(), outputBuf);
+    }
+    return outputBuf[0];
+}
+
+bool ESRegExpObject::compileIfNeeded()
+{
     if (!m_bytecodePattern) {
         RegExpCacheEntry& entry = getCacheEntryAndCompileIfNeeded(m_source, m_option);
-        if (entry.m_yarrError) {
-            matchResult.m_subPatternNum = 0;
+        if (entry.m_yarrError)
             return false;
-        }
         m_yarrPattern = entry.m_yarrPattern;
 
         if (entry.m_bytecodePattern) {
             m_bytecodePattern = entry.m_bytecodePattern;
         } else {
-            WTF::BumpPointerAllocator *bumpAlloc = ESVMInstance::currentInstance()->bumpPointerAllocator();
+            ESVMInstance* instance = ESVMInstance::currentInstance();
+            size_t usageBefore = instance->nativeHeapUsage();
+            // only used as scratch space while matching, so every pattern shares it
+            WTF::BumpPointerAllocator *bumpAlloc = instance->bumpPointerAllocator();
             JSC::Yarr::OwnPtr<JSC::Yarr::BytecodePattern> ownedBytecode = JSC::Yarr::byteCompile(*m_yarrPattern, bumpAlloc);
             m_bytecodePattern = ownedBytecode.leakPtr();
             entry.m_bytecodePattern = m_bytecodePattern;
+            entry.m_prefilter = RegExpPrefilter::create(*m_yarrPattern);
+            entry.m_matcher = RegExpMatcher::compile(*m_yarrPattern, entry.m_prefilter);
+            instance->m_regexpCacheCompileCount++;
+
+            size_t bytes = sizeof(JSC::Yarr::BytecodePattern) + nativeHeapGrowthSince(instance, usageBefore);
+            if (entry.m_prefilter)
+                bytes += entry.m_prefilter->memoryUsage();
+            if (entry.m_matcher)
+                bytes += entry.m_matcher->memoryUsage();
+            // may evict other entries, but never this one
+            instance->addRegExpCacheBytes(entry, bytes);
         }
+        m_matcher = entry.m_matcher;
+        m_prefilter = entry.m_prefilter;
+    }
+    return true;
+}
+
+unsigned ESRegExpObject::subPatternNum()
+{
+    ASSERT(m_bytecodePattern);
+    return m_bytecodePattern->m_body->m_numSubpatterns;
+}
+
+template <typename CharType>
+ALWAYS_INLINE unsigned ESRegExpObject::matchChars(const CharType* chars, size_t length, size_t start, unsigned* outputBuf)
+{
+    memset(outputBuf, -1, sizeof(unsigned) * 2 * (subPatternNum() + 1));
+    if (start > length)
+        return JSC::Yarr::offsetNoMatch;
+    return matchRegExp(m_source, m_bytecodePattern, m_matcher, m_prefilter, chars, length, start, outputBuf);
+}
+
+bool ESRegExpObject::matchAt(const escargot::ESString* str, size_t startIndex, unsigned* output)
+{
+    ASSERT(m_bytecodePattern);
+    unsigned result;
+    if (str->isASCIIString())
+        result = matchChars(str->asciiData(), str->length(), startIndex, output);
+    else
+        result = matchChars(str->utf16Data(), str->length(), startIndex, output);
+    return result != JSC::Yarr::offsetNoMatch;
+}
+
+bool ESRegExpObject::match(const escargot::ESString* str, RegexMatchResult& matchResult, bool testOnly, size_t startIndex)
+{
+    m_lastExecutedString = str;
+
+    if (!compileIfNeeded()) {
+        matchResult.m_subPatternNum = 0;
+        return false;
     }
 
     unsigned subPatternNum = m_bytecodePattern->m_body->m_numSubpatterns;
@@ -1637,13 +1912,10 @@ bool ESRegExpObject::match(const escargot::ESString* str, RegexMatchResult& matc
     outputBuf[1] = start;
     do {
         start = outputBuf[1];
-        memset(outputBuf, -1, sizeof(unsigned) * 2 * (subPatternNum + 1));
-        if (start > length)
-            break;
         if (str->isASCIIString())
-            result = JSC::Yarr::interpret(m_bytecodePattern, (const char *)chars, length, start, outputBuf);
+            result = matchChars((const char *)chars, length, start, outputBuf);
         else
-            result = JSC::Yarr::interpret(m_bytecodePattern, (const UChar *)chars, length, start, outputBuf);
+            result = matchChars((const char16_t *)chars, length, start, outputBuf);
         if (result != JSC::Yarr::offsetNoMatch) {
             if (UNLIKELY(testOnly)) {
                 // outputBuf[1] should be set to lastIndex
@@ -1704,24 +1976,6 @@ ESArrayObject* ESRegExpObject::createRegExpMatchedArray(const RegexMatchResult&
     return arr;
 }
 
-ESArrayObject* ESRegExpObject::pushBackToRegExpMatchedArray(escargot::ESArrayObject* array, size_t& index, const size_t limit, const RegexMatchResult& result, const escargot::ESString* str)
-{
-    for (unsigned i = 0; i < result.m_matchResults.size(); i ++) {
-        for (unsigned j = 0; j < result.m_matchResults[i].size(); j ++) {
-            if (i == 0 && j == 0)
-                continue;
-
-            if (std::numeric_limits<unsigned>::max() == result.m_matchResults[i][j].m_start)
-                array->defineDataProperty(ESValue(index++), true, true, true, ESValue(ESValue::ESUndefined));
-            else
-                array->defineDataProperty(ESValue(index++), true, true, true, str->substring(result.m_matchResults[i][j].m_start, result.m_matchResults[i][j].m_end));
-            if (index == limit)
-                return array;
-        }
-    }
-    return array;
-}
-
 ESFunctionObject::ESFunctionObject(LexicalEnvironment* outerEnvironment, CodeBlock* cb, escargot::ESString* name, unsigned length, bool hasPrototype, bool isBuiltIn)
     : ESObject((Type)(Type::ESObject | Type::ESFunctionObject), ESVMInstance::currentInstance()->globalFunctionPrototype(), 4)
 {
@@ -2222,6 +2476,7 @@ ESValue ESFunctionObject::call(ESVMInstance* instance, const ESValue& callee, co
             auto FE = LexicalEnvironment::newFunctionEnvironment(cb->m_needsToPrepareGenerateArgumentsObject,
                 stackStorage, cb->m_stackAllocatedIdentifiersCount, cb->m_heapAllocatedIdentifiers, arguments, argumentCount, fn, cb->m_needsActivation, cb->m_functionExpressionNameIndex);
             instance->m_currentExecutionContext = new ExecutionContext(FE, isNewExpression, cb->shouldUseStrictMode(), callStackInformation, arguments, argumentCount);
+            instance->m_currentExecutionContext->setCallerContext(currentContext);
             FunctionEnvironmentRecord* record = (FunctionEnvironmentRecord *)FE->record();
             functionCallerInnerProcess(instance->m_currentExecutionContext, fn, cb, record, stackStorage, receiver, arguments, argumentCount, instance, &outerFENameRegistered);
 
@@ -2237,6 +2492,7 @@ ESValue ESFunctionObject::call(ESVMInstance* instance, const ESValue& callee, co
                     stackStorage, cb->m_stackAllocatedIdentifiersCount, cb->m_heapAllocatedIdentifiers, cb->m_needsActivation, cb->m_functionExpressionNameIndex);
                 LexicalEnvironment env(&envRec, fn->outerEnvironment());
                 ExecutionContext ec(&env, isNewExpression, cb->shouldUseStrictMode(), callStackInformation, arguments, argumentCount);
+                ec.setCallerContext(currentContext);
                 instance->m_currentExecutionContext = &ec;
                 functionCallerInnerProcess(&ec, fn, cb, &envRec, stackStorage, receiver, arguments, argumentCount, instance, &outerFENameRegistered);
 #ifdef ENABLE_ESJIT
@@ -2249,6 +2505,7 @@ ESValue ESFunctionObject::call(ESVMInstance* instance, const ESValue& callee, co
                     stackStorage, cb->m_stackAllocatedIdentifiersCount, cb->m_heapAllocatedIdentifiers, cb->m_needsActivation, cb->m_functionExpressionNameIndex);
                 LexicalEnvironment env(&envRec, fn->outerEnvironment());
                 ExecutionContext ec(&env, isNewExpression, cb->shouldUseStrictMode(), callStackInformation, arguments, argumentCount);
+                ec.setCallerContext(currentContext);
                 instance->m_currentExecutionContext = &ec;
                 functionCallerInnerProcess(&ec, fn, cb, &envRec, stackStorage, receiver, arguments, argumentCount, instance, &outerFENameRegistered);
 #ifdef ENABLE_ESJIT
@@ -3986,63 +4243,99 @@ ESArrayBufferObject::ESArrayBufferObject(ESPointer::Type type)
     : ESObject((Type)(Type::ESObject | Type::ESArrayBufferObject), ESVMInstance::currentInstance()->globalObject()->arrayBufferPrototype())
     , m_data(NULL)
     , m_bytelength(0)
+    , m_storage(GCHeapStorage)
+    , m_releaseCallback(NULL)
+    , m_releaseData(NULL)
+    , m_instance(NULL)
 {
     set__proto__(ESVMInstance::currentInstance()->globalObject()->arrayBufferPrototype());
 }
 
-ESArrayBufferView::ESArrayBufferView(ESPointer::Type type, ESValue __proto__)
-    : ESObject((Type)(Type::ESObject | Type::ESArrayBufferView | type), __proto__)
+void ESArrayBufferObject::allocateArrayBuffer(unsigned bytelength)
 {
-}
+    ASSERT(isDetachedBuffer());
+    if (bytelength < options::ArrayBufferMallocThreshold) {
+        m_data = GC_MALLOC_ATOMIC(bytelength);
+        memset(m_data, 0, bytelength);
+        m_bytelength = bytelength;
+        m_storage = GCHeapStorage;
+        return;
+    }
 
-ESValue ESTypedArrayObjectWrapper::get(uint32_t key)
-{
-    switch (m_arraytype) {
-    case TypedArrayType::Int8Array:
-        return (reinterpret_cast<ESInt8Array *>(this))->get(key);
-    case TypedArrayType::Uint8Array:
-        return (reinterpret_cast<ESUint8Array *>(this))->get(key);
-    case TypedArrayType::Uint8ClampedArray:
-        return (reinterpret_cast<ESUint8ClampedArray *>(this))->get(key);
-    case TypedArrayType::Int16Array:
-        return (reinterpret_cast<ESInt16Array *>(this))->get(key);
-    case TypedArrayType::Uint16Array:
-        return (reinterpret_cast<ESUint16Array *>(this))->get(key);
-    case TypedArrayType::Int32Array:
-        return (reinterpret_cast<ESInt32Array *>(this))->get(key);
-    case TypedArrayType::Uint32Array:
-        return (reinterpret_cast<ESUint32Array *>(this))->get(key);
-    case TypedArrayType::Float32Array:
-        return (reinterpret_cast<ESFloat32Array *>(this))->get(key);
-    case TypedArrayType::Float64Array:
-        return (reinterpret_cast<ESFloat64Array *>(this))->get(key);
+    Storage storage;
+    void* data;
+    if (bytelength < options::ArrayBufferMmapThreshold) {
+        storage = MallocStorage;
+        data = calloc(1, bytelength);
+    } else {
+        storage = MmapStorage;
+        data = mmap(NULL, bytelength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED)
+            data = NULL;
     }
-    RELEASE_ASSERT_NOT_REACHED();
+    if (!data)
+        ESVMInstance::currentInstance()->throwOOMError();
+    m_data = data;
+    m_bytelength = bytelength;
+    setOffHeapStorage(storage);
+    // counted last: going over the native heap limit throws, and the contents are ours by now
+    m_instance = ESVMInstance::currentInstance();
+    m_instance->nativeHeapAllocated(bytelength, data);
 }
-bool ESTypedArrayObjectWrapper::set(uint32_t key, ESValue val)
-{
-    switch (m_arraytype) {
-    case TypedArrayType::Int8Array:
-        return (reinterpret_cast<ESInt8Array *>(this))->set(key, val);
-    case TypedArrayType::Uint8Array:
-        return (reinterpret_cast<ESUint8Array *>(this))->set(key, val);
-    case TypedArrayType::Uint8ClampedArray:
-        return (reinterpret_cast<ESUint8ClampedArray *>(this))->set(key, val);
-    case TypedArrayType::Int16Array:
-        return (reinterpret_cast<ESInt16Array *>(this))->set(key, val);
-    case TypedArrayType::Uint16Array:
-        return (reinterpret_cast<ESUint16Array *>(this))->set(key, val);
-    case TypedArrayType::Int32Array:
-        return (reinterpret_cast<ESInt32Array *>(this))->set(key, val);
-    case TypedArrayType::Uint32Array:
-        return (reinterpret_cast<ESUint32Array *>(this))->set(key, val);
-    case TypedArrayType::Float32Array:
-        return (reinterpret_cast<ESFloat32Array *>(this))->set(key, val);
-    case TypedArrayType::Float64Array:
-        return (reinterpret_cast<ESFloat64Array *>(this))->set(key, val);
+
+void ESArrayBufferObject::attachExternalArrayBuffer(void* buffer, size_t length, ReleaseCallback release, void* releaseData)
+{
+    ASSERT(isDetachedBuffer());
+    m_data = buffer;
+    m_bytelength = length;
+    m_releaseCallback = release;
+    m_releaseData = releaseData;
+    setOffHeapStorage(ExternalStorage);
+}
+
+// Only buffers whose contents live outside the collector heap pay for a finalizer
+void ESArrayBufferObject::setOffHeapStorage(Storage storage)
+{
+    m_storage = storage;
+    GC_REGISTER_FINALIZER_NO_ORDER(this, [] (void* obj, void* cd) {
+        ((ESArrayBufferObject *)obj)->releaseStorage();
+    }, NULL, NULL, NULL);
+}
+
+void ESArrayBufferObject::releaseStorage()
+{
+    if (m_storage == GCHeapStorage)
+        return;
+    GC_REGISTER_FINALIZER_NO_ORDER(this, NULL, NULL, NULL, NULL);
+
+    switch (m_storage) {
+    case MallocStorage:
+        free(m_data);
+        break;
+    case MmapStorage:
+        munmap(m_data, m_bytelength);
+        break;
+    case ExternalStorage:
+        if (m_releaseCallback)
+            m_releaseCallback(m_data, m_bytelength, m_releaseData);
+        m_releaseCallback = NULL;
+        m_releaseData = NULL;
+        break;
+    default:
+        RELEASE_ASSERT_NOT_REACHED();
     }
-    RELEASE_ASSERT_NOT_REACHED();
+    // the finalizer may run while another instance, or none, is entered
+    if (m_instance)
+        m_instance->nativeHeapDeallocated(m_bytelength, m_data);
+    m_instance = NULL;
+    m_storage = GCHeapStorage;
+}
+
+ESArrayBufferView::ESArrayBufferView(ESPointer::Type type, ESValue __proto__)
+    : ESObject((Type)(Type::ESObject | Type::ESArrayBufferView | type), __proto__)
+{
 }
+
 #endif
 
 ESArgumentsObject::ESArgumentsObject(FunctionEnvironmentRecordWithArgumentsObject* environment)
@@ -25,6 +25,7 @@
 #define ESValue_h
 
 #include "InternalString.h"
+#include "vm/HeapProfiler.h"
 
 namespace JSC {
 namespace Yarr {
@@ -43,6 +44,9 @@ class ESRopeString;
 class ESObject;
 class ESSlot;
 class ESHiddenClass;
+class JSONStringifyCache;
+class RegExpMatcher;
+class RegExpPrefilter;
 class ESFunctionObject;
 class ESArrayObject;
 class ESStringObject;
@@ -312,16 +316,27 @@ public:
         ESControlFlowRecord = 1 << 18,
         ESJSONObject = 1 << 19,
         TypeMask = 0x3ffff,
-        TotalNumberOfTypes = 19
+        TotalNumberOfTypes = 20
     };
 
 protected:
     ESPointer(Type type)
     {
         m_type = type;
+        m_allocationCount[typeIndex(type)]++;
+        HeapProfiler::allocated(this);
     }
 
 public:
+    // the most derived type of a combined type
+    static ALWAYS_INLINE size_t typeIndex(int type)
+    {
+        return sizeof(unsigned) * 8 - 1 - __builtin_clz((unsigned)type);
+    }
+    static const char* typeName(size_t typeIndex);
+    // objects created so far, by typeIndex
+    static size_t m_allocationCount[TotalNumberOfTypes];
+
     ALWAYS_INLINE int type()
     {
         return m_type;
@@ -625,22 +640,12 @@ size_t stringHash(const T* s, size_t len, size_t seed = 0)
 
 inline bool isAllASCII(const char* buf, const size_t& len)
 {
-    for (unsigned i = 0; i < len ; i ++) {
-        if ((buf[i] & 0x80) != 0) {
-            return false;
-        }
-    }
-    return true;
+    return asciiPrefixLength(buf, len) == len;
 }
 
 inline bool isAllASCII(const char16_t* buf, const size_t& len)
 {
-    for (unsigned i = 0; i < len ; i ++) {
-        if (buf[i] >= 128) {
-            return false;
-        }
-    }
-    return true;
+    return asciiPrefixLength(buf, len) == len;
 }
 
 static const char32_t offsetsFromUTF8[6] = { 0x00000000UL, 0x00003080UL, 0x000E2080UL, 0x03C82080UL, static_cast<char32_t>(0xFA082080UL), static_cast<char32_t>(0x82082080UL) };
@@ -699,29 +704,50 @@ inline char32_t readUTF8Sequence(const char*& sequence, bool& valid, int& charle
 
 inline UTF16String utf8StringToUTF16String(const char* buf, const size_t& len)
 {
+    // no byte decodes to more than one code unit, so len is enough
     UTF16String str;
+    str.resize(len);
+    char16_t* dst = &str[0];
+    size_t dstLength = 0;
     const char* source = buf;
     int charlen;
     bool valid;
     while (source < buf + len) {
+        // widen runs of ASCII in bulk, then let the vector decoder take what it can,
+        // and decode the rest one sequence at a time
+        size_t asciiLength = asciiPrefixLength(source, buf + len - source);
+        if (asciiLength) {
+            widenASCII(source, asciiLength, dst + dstLength);
+            dstLength += asciiLength;
+            source += asciiLength;
+            continue;
+        }
+        size_t decodedLength;
+        size_t decodedBytes = decodeUTF8(source, buf + len - source, dst + dstLength, &decodedLength);
+        if (decodedBytes) {
+            source += decodedBytes;
+            dstLength += decodedLength;
+            continue;
+        }
         char32_t ch = readUTF8Sequence(source, valid, charlen);
         if (!valid) { // Invalid sequence
-            str += 0xFFFD;
+            dst[dstLength++] = 0xFFFD;
         } else if (((uint32_t)(ch) <= 0xffff)) { // BMP
             if ((((ch) & 0xfffff800) == 0xd800)) { // SURROGATE
-                str += 0xFFFD;
+                dst[dstLength++] = 0xFFFD;
                 source -= (charlen - 1);
             } else {
-                str += ch; // normal case
+                dst[dstLength++] = ch; // normal case
             }
         } else if (((uint32_t)((ch) - 0x10000) <= 0xfffff)) { // SUPPLEMENTARY
-            str += (char16_t)(((ch) >> 10) + 0xd7c0); // LEAD
-            str += (char16_t)(((ch) & 0x3ff) | 0xdc00); // TRAIL
+            dst[dstLength++] = (char16_t)(((ch) >> 10) + 0xd7c0); // LEAD
+            dst[dstLength++] = (char16_t)(((ch) & 0x3ff) | 0xdc00); // TRAIL
         } else {
-            str += 0xFFFD;
+            dst[dstLength++] = 0xFFFD;
             source -= (charlen - 1);
         }
     }
+    str.resize(dstLength);
 
     return UTF16String(std::move(str));
 }
@@ -729,11 +755,8 @@ inline UTF16String utf8StringToUTF16String(const char* buf, const size_t& len)
 inline ASCIIString utf16StringToASCIIString(const char16_t* buf, const size_t& len)
 {
     ASCIIString str;
-    str.reserve(len);
-    for (unsigned i = 0 ; i < len ; i ++) {
-        ASSERT(buf[i] < 128);
-        str += buf[i];
-    }
+    str.resize(len);
+    narrowASCII(buf, len, &str[0]);
     return ASCIIString(std::move(str));
 }
 
@@ -800,6 +823,8 @@ public:
     static ESString* create(const char* str);
     static ESString* createAtomicString(const char* str);
     static ESString* concatTwoStrings(ESString* lstr, ESString* rstr);
+    // concatenation whose result replaces lstr (s += x)
+    static ESString* appendTwoStrings(ESString* lstr, ESString* rstr);
     NullableUTF8String toNullableUTF8String() const;
     NullableUTF16String toNullableUTF16String() const;
     ASCIIString* asASCIIString() const;
@@ -912,6 +937,9 @@ public:
     }
     ESString* substring(int from, int to) const;
 
+    // three-way comparison which walks ropes piece by piece instead of flattening them
+    static int compareSlowCase(const ESString& a, const ESString& b);
+
     ESString(const ESString& s) = delete;
     void operator =(const ESString& s) = delete;
     static constexpr size_t maxLength() { return options::MaximumStringLength; }
@@ -925,9 +953,6 @@ public:
     ALWAYS_INLINE friend bool operator <= (const ESString& a, const ESString& b);
     ALWAYS_INLINE friend bool operator >= (const ESString& a, const ESString& b);
 
-    size_t createRegexMatchResult(escargot::ESRegExpObject* regexp, RegexMatchResult& result);
-    escargot::ESArrayObject* createMatchedArray(escargot::ESRegExpObject* regexp, RegexMatchResult& result);
-
 #ifndef NDEBUG
     void show() const
     {
@@ -1005,12 +1030,7 @@ ALWAYS_INLINE bool stringEqual(const T* s, const T* s1, const size_t& len)
 
 ALWAYS_INLINE bool stringEqual(const char16_t* s, const char* s1, const size_t& len)
 {
-    for (size_t i = 0; i < len ; i ++) {
-        if (s[i] != s1[i]) {
-            return false;
-        }
-    }
-    return true;
+    return stringMismatch(s, s1, len) == len;
 }
 
 ALWAYS_INLINE bool operator == (const ESString& a, const char* b)
@@ -1032,26 +1052,30 @@ ALWAYS_INLINE bool operator != (const ESString& a, const char* b)
 
 ALWAYS_INLINE bool operator == (const ESString& a, const ESString& b)
 {
+    // atomic strings are always the same object
+    if (&a == &b)
+        return true;
     size_t lenA = a.length();
     size_t lenB = b.length();
-    if (lenA == lenB) {
-        if (a.hashValue() == b.hashValue()) {
-            bool aa = a.isASCIIString();
-            bool bb = b.isASCIIString();
-            ESString* dataA = a.unwrap();
-            ESString* dataB = b.unwrap();
-            if (aa && bb) {
-                return stringEqual(dataA->uncheckedAsASCIIString()->data(), dataB->uncheckedAsASCIIString()->data(), lenA);
-            } else if (aa && !bb) {
-                return stringEqual(dataB->uncheckedAsUTF16String()->data(), dataA->uncheckedAsASCIIString()->data(), lenA);
-            } else if (!aa && bb) {
-                return stringEqual(dataA->uncheckedAsUTF16String()->data(), dataB->uncheckedAsASCIIString()->data(), lenA);
-            } else {
-                return stringEqual(dataA->uncheckedAsUTF16String()->data(), dataB->uncheckedAsUTF16String()->data(), lenA);
-            }
-        }
+    if (lenA != lenB)
+        return false;
+    // hash of a rope is only known after flattening
+    if (UNLIKELY(a.isESRopeString() || b.isESRopeString()))
+        return ESString::compareSlowCase(a, b) == 0;
+    if (a.m_data.m_hashData != b.m_data.m_hashData)
+        return false;
+
+    bool aa = a.m_data.m_isASCIIString;
+    bool bb = b.m_data.m_isASCIIString;
+    if (aa && bb) {
+        return stringEqual(a.uncheckedAsASCIIString()->data(), b.uncheckedAsASCIIString()->data(), lenA);
+    } else if (aa && !bb) {
+        return stringEqual(b.uncheckedAsUTF16String()->data(), a.uncheckedAsASCIIString()->data(), lenA);
+    } else if (!aa && bb) {
+        return stringEqual(a.uncheckedAsUTF16String()->data(), b.uncheckedAsASCIIString()->data(), lenA);
+    } else {
+        return stringEqual(a.uncheckedAsUTF16String()->data(), b.uncheckedAsUTF16String()->data(), lenA);
     }
-    return false;
 }
 
 ALWAYS_INLINE bool operator != (const ESString& a, const ESString& b)
@@ -1062,16 +1086,11 @@ ALWAYS_INLINE bool operator != (const ESString& a, const ESString& b)
 template<typename T1, typename T2>
 ALWAYS_INLINE int stringCompare(size_t l1, size_t l2, const T1* c1, const T2* c2)
 {
-    const unsigned lmin = l1 < l2 ? l1 : l2;
-    unsigned pos = 0;
-    while (pos < lmin && *c1 == *c2) {
-        ++c1;
-        ++c2;
-        ++pos;
-    }
+    const size_t lmin = l1 < l2 ? l1 : l2;
+    size_t pos = stringMismatch(c1, c2, lmin);
 
     if (pos < lmin)
-        return (c1[0] > c2[0]) ? 1 : -1;
+        return (c1[pos] > c2[pos]) ? 1 : -1;
 
     if (l1 == l2)
         return 0;
@@ -1081,6 +1100,11 @@ ALWAYS_INLINE int stringCompare(size_t l1, size_t l2, const T1* c1, const T2* c2
 
 ALWAYS_INLINE int stringCompare(const ESString& a, const ESString& b)
 {
+    if (&a == &b)
+        return 0;
+    if (UNLIKELY(a.isESRopeString() || b.isESRopeString()))
+        return ESString::compareSlowCase(a, b);
+
     size_t lenA = a.length();
     bool aa = a.isASCIIString();
     size_t lenB = b.length();
@@ -1119,8 +1143,37 @@ ALWAYS_INLINE bool operator >= (const ESString& a, const ESString& b)
 
 typedef std::vector<ESString *, gc_allocator<ESString *> > ESStringVector;
 
+// Growable storage behind ropes built by appending in place (s += x).
+// Each of those ropes covers a prefix of the buffer, and only the rope covering all of it
+// may append more, so the contents of existing ropes never change.
+class ESStringAppendBuffer : public gc {
+public:
+    ESStringAppendBuffer()
+    {
+        m_isASCIIString = true;
+    }
+
+    size_t length() const
+    {
+        return m_isASCIIString ? m_asciiBuffer.size() : m_utf16Buffer.size();
+    }
+
+    void append(ESString* str);
+
+    char16_t charAt(size_t idx) const
+    {
+        return m_isASCIIString ? m_asciiBuffer[idx] : m_utf16Buffer[idx];
+    }
+
+    bool m_isASCIIString;
+    // switches to m_utf16Buffer on the first non-ASCII append
+    std::vector<char, pointer_free_allocator<char> > m_asciiBuffer;
+    std::vector<char16_t, pointer_free_allocator<char16_t> > m_utf16Buffer;
+};
+
 class ESRopeString : public ESString {
     friend class ESString;
+    friend class ESStringPieceCursor;
 protected:
     ESRopeString()
         : ESString((ESPointer::Type)(ESPointer::ESString | ESPointer::ESRopeString))
@@ -1130,6 +1183,7 @@ protected:
         m_left = nullptr;
         m_right = nullptr;
         m_content = nullptr;
+        m_appendBuffer = nullptr;
     }
 public:
     static const unsigned ESRopeStringCreateMinLimit = 24;
@@ -1139,6 +1193,7 @@ public:
     }
 
     static ESRopeString* createAndConcat(ESString* lstr, ESString* rstr);
+    static ESRopeString* createAndAppend(ESRopeString* lstr, ESString* rstr);
 
     bool hasNonASCIIChild() const
     {
@@ -1161,6 +1216,8 @@ protected:
     ESString* m_left;
     ESString* m_right;
     ESString* m_content;
+    // set instead of m_left and m_right for ropes made by createAndAppend
+    ESStringAppendBuffer* m_appendBuffer;
     size_t m_contentLength;
     bool m_hasNonASCIIString;
 };
@@ -1186,11 +1243,6 @@ inline ESString* ESString::create(const UTF16String& src)
     return new ESUTF16String(std::move(UTF16String(src)));
 }
 
-inline ESString* ESString::create(int number)
-{
-    return ESString::create((double)number);
-}
-
 inline ESString* ESString::create(char c)
 {
     return new ESASCIIString(std::move(ASCIIString({c})));
@@ -1222,6 +1274,12 @@ inline ESString* ESString::data() const
 
 inline char16_t ESString::charAt(const size_t& idx) const
 {
+    if (UNLIKELY(isESRopeString())) {
+        // read appended ropes without flattening them
+        escargot::ESRopeString* rope = (escargot::ESRopeString*)this;
+        if (!rope->m_content && rope->m_appendBuffer)
+            return rope->m_appendBuffer->charAt(idx);
+    }
     ESString* s = data();
     if (LIKELY(s->m_data.m_isASCIIString)) {
         return (*s->uncheckedAsASCIIString())[idx];
@@ -1332,10 +1390,7 @@ inline NullableUTF16String ESString::toNullableUTF16String() const
     if (s->isASCIIString()) {
         size_t siz = s->asASCIIString()->length();
         char16_t* v = (char16_t *)GC_MALLOC_ATOMIC(sizeof(char16_t) * siz);
-        const char* src = s->asASCIIString()->data();
-        for (size_t i = 0; i < siz ; i ++) {
-            v[i] = src[i];
-        }
+        widenASCII(s->asASCIIString()->data(), siz, v);
         return NullableUTF16String(v, siz);
     } else {
         return NullableUTF16String(s->asUTF16String()->data(), s->asUTF16String()->length());
@@ -1348,11 +1403,8 @@ inline UTF16String ESString::toUTF16String() const
     if (isASCIIString()) {
         UTF16String str;
         size_t s = ss->asASCIIString()->length();
-        str.reserve(s);
-        const char* src = ss->asASCIIString()->data();
-        for (size_t i = 0; i < s ; i ++) {
-            str += src[i];
-        }
+        str.resize(s);
+        widenASCII(ss->asASCIIString()->data(), s, &str[0]);
         return std::move(str);
     } else {
         return *(ss->asUTF16String());
@@ -1632,6 +1684,18 @@ public:
     }
     void setHasEverSetAsPrototypeObjectHiddenClass() { m_flags.m_hasEverSetAsPrototypeObjectHiddenClass = true; }
 
+    // see JSONStringifier.cpp. only vector mode classes carry one because they never change
+    JSONStringifyCache* jsonStringifyCache()
+    {
+        return m_jsonStringifyCache;
+    }
+
+    void setJSONStringifyCache(JSONStringifyCache* cache)
+    {
+        ASSERT(isVectorMode());
+        m_jsonStringifyCache = cache;
+    }
+
     ALWAYS_INLINE ESValue read(ESObject* obj, ESValue originalObject, ESString* propertyName, ESString* name);
     ALWAYS_INLINE ESValue read(ESObject* obj, ESValue originalObject, ESString* propertyName, size_t index);
 
@@ -1685,12 +1749,14 @@ private:
         m_flags.m_hasIndexedReadOnlyProperty = false;
         m_flags.m_hasEverSetAsPrototypeObjectHiddenClass = false;
         m_propertyIndexHashMapInfo = NULL;
+        m_jsonStringifyCache = NULL;
     }
 
     ESHiddenClass(const ESHiddenClass& other)
         : m_propertyIndexHashMapInfo(other.m_propertyIndexHashMapInfo)
         , m_propertyInfo(std::move(other.m_propertyInfo))
         , m_transitionData(0)
+        , m_jsonStringifyCache(NULL)
     {
         ASSERT(other.m_flags.m_isVectorMode == false); // this function is currently used only for vector mode
         m_flags = other.m_flags;
@@ -1699,6 +1765,7 @@ private:
     ESHiddenClassPropertyIndexHashMapInfo* m_propertyIndexHashMapInfo;
     ESHiddenClassPropertyInfoVector m_propertyInfo;
     ESHiddenClassTransitionDataStd m_transitionData;
+    JSONStringifyCache* m_jsonStringifyCache;
 
     struct {
         bool m_isVectorMode:1;
@@ -1824,6 +1891,8 @@ class ESObject : public ESPointer {
     friend ALWAYS_INLINE void setObjectPreComputedCaseOperation(ESValue* willBeObject, ::escargot::ESString* keyString, const ESValue& value
         , ESHiddenClassChain* cachedHiddenClassChain, size_t* cachedHiddenClassIndex, ESHiddenClass** hiddenClassWillBe);
     friend class GlobalObject;
+    template <typename CharType> friend class JSONObjectBuilder;
+    template <typename CharType> friend class JSONStringifier;
 protected:
     ESObject(ESPointer::Type type, ESValue __proto__, size_t initialKeyCount = 6);
 public:
@@ -1953,6 +2022,15 @@ public:
         return (ESPropertyAccessorData *)m_hiddenClassData[idx].asESPointer();
     }
 
+    // does not call getters: empty for a missing or accessor property
+    ESValue ownDataPropertyValue(escargot::ESString* key)
+    {
+        size_t idx = m_hiddenClass->findProperty(key);
+        if (idx == SIZE_MAX || !m_hiddenClass->propertyInfo(idx).isDataProperty())
+            return ESValue(ESValue::ESEmptyValue);
+        return m_hiddenClassData[idx];
+    }
+
     // http://www.ecma-international.org/ecma-262/6.0/index.html#sec-get-o-p
     ALWAYS_INLINE ESValue get(escargot::ESValue key, ESValue* receiver = nullptr);
     ALWAYS_INLINE ESValue getOwnProperty(escargot::ESValue key);
@@ -1981,8 +2059,9 @@ public:
     template <typename Functor>
     ALWAYS_INLINE void enumerationWithNonEnumerable(Functor t);
 
-    template <typename Comp>
-    ALWAYS_INLINE void sort(const Comp& c);
+    // sortValues sorts the present elements other than undefined, which go after them
+    template <typename SortValues>
+    ALWAYS_INLINE void sort(const SortValues& sortValues);
 
     ALWAYS_INLINE const ESValue& __proto__()
     {
@@ -2702,22 +2781,35 @@ public:
 
         bool operator == (const RegExpCacheKey& otherKey) const
         {
-            return (m_body == otherKey.m_body) && (m_multiline == otherKey.m_multiline) && (m_ignoreCase == otherKey.m_ignoreCase);
+            return (*m_body == *otherKey.m_body) && (m_multiline == otherKey.m_multiline) && (m_ignoreCase == otherKey.m_ignoreCase);
         }
         const escargot::ESString* m_body;
         const bool m_multiline;
         const bool m_ignoreCase;
     };
 
+    // most recently used first
+    typedef std::list<RegExpCacheKey, gc_allocator<RegExpCacheKey> > RegExpCacheLRUList;
+
     struct RegExpCacheEntry {
         RegExpCacheEntry(const char* yarrError = nullptr, JSC::Yarr::YarrPattern* yarrPattern = nullptr, JSC::Yarr::BytecodePattern* bytecodePattern = nullptr)
             : m_yarrError(yarrError)
             , m_yarrPattern(yarrPattern)
-            , m_bytecodePattern(bytecodePattern) { }
+            , m_bytecodePattern(bytecodePattern)
+            , m_matcher(nullptr)
+            , m_prefilter(nullptr)
+            , m_bytes(0) { }
 
         const char* m_yarrError;
         JSC::Yarr::YarrPattern* m_yarrPattern;
         JSC::Yarr::BytecodePattern* m_bytecodePattern;
+        // compiled together with m_bytecodePattern; NULL if the pattern needs the interpreter
+        RegExpMatcher* m_matcher;
+        // NULL if a match could start anywhere
+        RegExpPrefilter* m_prefilter;
+        // approximate size of everything above, counted against options::RegExpCacheSizeThreshold
+        size_t m_bytes;
+        RegExpCacheLRUList::iterator m_lruPosition;
     };
 
     static ESRegExpObject* create(const escargot::ESValue patternStr, const escargot::ESValue optionStr);
@@ -2757,9 +2849,19 @@ public:
     }
 
     escargot::ESArrayObject* createRegExpMatchedArray(const RegexMatchResult& result, const escargot::ESString* input);
-    escargot::ESArrayObject* pushBackToRegExpMatchedArray(escargot::ESArrayObject* array, size_t& index, const size_t limit, const RegexMatchResult& result, const escargot::ESString* str);
+
+    // compiles the pattern on first use; false if the source is invalid
+    bool compileIfNeeded();
+    // the following require compileIfNeeded()
+    unsigned subPatternNum();
+    // One search from startIndex, ignoring lastIndex and the global flag, without building a RegexMatchResult.
+    // output receives 2 * (subPatternNum() + 1) offsets, -1 for groups which did not participate
+    bool matchAt(const escargot::ESString* str, size_t startIndex, unsigned* output);
 
 private:
+    template <typename CharType>
+    unsigned matchChars(const CharType* chars, size_t length, size_t start, unsigned* outputBuf);
+
     void setBytecodePattern(JSC::Yarr::BytecodePattern* pattern)
     {
         m_bytecodePattern = pattern;
@@ -2769,6 +2871,8 @@ private:
     escargot::ESString* m_source;
     JSC::Yarr::YarrPattern* m_yarrPattern;
     JSC::Yarr::BytecodePattern* m_bytecodePattern;
+    RegExpMatcher* m_matcher;
+    RegExpPrefilter* m_prefilter;
     Option m_option;
 
     ESValue m_lastIndex;
@@ -2827,13 +2931,20 @@ public:
         return obj;
     }
 
-    void allocateArrayBuffer(unsigned bytelength)
+    typedef void (*ReleaseCallback)(void* data, size_t length, void* releaseData);
+
+    // Wraps memory owned by the embedder (a file mapping, a network buffer) without copying.
+    // release is called once the buffer is detached or collected; it may be NULL.
+    static ESArrayBufferObject* createExternal(void* data, unsigned bytelength, ReleaseCallback release, void* releaseData)
     {
-        m_bytelength = bytelength;
-        m_data = GC_MALLOC_ATOMIC(bytelength);
-        memset(m_data, 0, bytelength);
+        ESArrayBufferObject* obj = new ESArrayBufferObject();
+        obj->attachExternalArrayBuffer(data, bytelength, release, releaseData);
+        return obj;
     }
 
+    // zero filled; see options::ArrayBufferMallocThreshold for where the contents live
+    void allocateArrayBuffer(unsigned bytelength);
+
     bool isDetachedBuffer()
     {
         if (data() == NULL)
@@ -2847,10 +2958,15 @@ public:
         ASSERT(isDetachedBuffer());
         m_data = buffer;
         m_bytelength = length;
+        m_storage = GCHeapStorage;
     }
 
+    void attachExternalArrayBuffer(void* buffer, size_t length, ReleaseCallback release, void* releaseData);
+
+    // contents outside of the collector heap are released right away
     void detachArrayBuffer()
     {
+        releaseStorage();
         m_data = NULL;
         m_bytelength = 0;
     }
@@ -2890,12 +3006,27 @@ public:
 
     void copyDataFrom(ESArrayBufferObject* other, unsigned start, unsigned length)
     {
-        memcpy((int8_t*)other->m_data + start, m_data, length);
+        memcpy(m_data, (int8_t*)other->m_data + start, length);
     }
 
 private:
+    enum Storage {
+        GCHeapStorage,
+        MallocStorage,
+        MmapStorage,
+        ExternalStorage,
+    };
+
+    void setOffHeapStorage(Storage storage);
+    void releaseStorage();
+
     void* m_data;
     unsigned m_bytelength;
+    Storage m_storage;
+    ReleaseCallback m_releaseCallback;
+    void* m_releaseData;
+    // the instance whose native heap counts the contents; NULL when nothing is counted
+    ESVMInstance* m_instance;
 };
 
 class ESArrayBufferView : public ESObject {
@@ -3016,8 +3147,11 @@ public:
         setBuffer(ESArrayBufferObject::createAndAllocate(m_bytelength));
     }
 
-    ESValue get(uint32_t key);
-    bool set(uint32_t key, ESValue val);
+    // inline loads and stores per element kind, for the interpreter and builtins
+    ALWAYS_INLINE ESValue get(uint32_t key);
+    ALWAYS_INLINE bool set(uint32_t key, ESValue val);
+    // the first element of this view
+    ALWAYS_INLINE void* rawData() { return (int8_t*)m_buffer->data() + m_byteoffset; }
     ALWAYS_INLINE unsigned arraylength() { return m_arraylength; }
     ALWAYS_INLINE void setArraylength(unsigned length) { m_arraylength = length; }
     ALWAYS_INLINE TypedArrayType arraytype() { return m_arraytype; }
@@ -1016,19 +1016,49 @@ ALWAYS_INLINE ESPointer* ESValue::asESPointer() const
 
 
 #endif
+inline ESString* ESString::create(int number)
+{
+    NumberToStringCacheEntry& entry = ESVMInstance::currentInstance()->numberToStringCacheEntry(number);
+    bool hit = entry.m_string && entry.m_number == number;
+    ESVMInstance::currentInstance()->countNumberToStringCacheHit(hit);
+    if (hit)
+        return entry.m_string;
+
+    // integers don't need dtoa
+    char buf[12];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    uint32_t n = number < 0 ? -(uint32_t)number : number;
+    do {
+        *--p = '0' + (n % 10);
+        n /= 10;
+    } while (n);
+    if (number < 0)
+        *--p = '-';
+
+    ESString* str = ESString::create(std::move(ASCIIString(p, end)));
+    entry.m_number = number;
+    entry.m_string = str;
+    return str;
+}
+
 inline ESString* ESString::create(double number)
 {
-#ifdef ENABLE_DTOACACHE
-    auto cache = ESVMInstance::currentInstance()->dtoaCache();
-    auto iter = cache->find(number);
-    if (iter != cache->end()) {
-        return iter->second;
+    if (number >= std::numeric_limits<int32_t>::min() && number <= std::numeric_limits<int32_t>::max()) {
+        int32_t i = (int32_t)number;
+        if (i == number && (i || !std::signbit(number)))
+            return ESString::create((int)i);
     }
-#endif
+
+    NumberToStringCacheEntry& entry = ESVMInstance::currentInstance()->numberToStringCacheEntry(number);
+    bool hit = entry.m_string && entry.m_number == number;
+    ESVMInstance::currentInstance()->countNumberToStringCacheHit(hit);
+    if (hit)
+        return entry.m_string;
+
     ESString* str = ESString::create(dtoa(number));
-#ifdef ENABLE_DTOACACHE
-    cache->insert(std::make_pair(number, str));
-#endif
+    entry.m_number = number;
+    entry.m_string = str;
     return str;
 }
 
@@ -2079,35 +2109,65 @@ ALWAYS_INLINE void ESObject::enumerationWithNonEnumerable(Functor t)
     }
 }
 
-template <typename Comp>
-ALWAYS_INLINE void ESObject::sort(const Comp& c)
+template <typename SortValues>
+ALWAYS_INLINE void ESObject::sort(const SortValues& sortValues)
 {
     if (isESArrayObject() && asESArrayObject()->isFastmode()) {
-        ESValueVectorStd values(asESArrayObject()->m_vector);
-        std::sort(values.begin(), values.end(), c);
-        for (size_t i = 0; i < values.size(); i++)
-            asESArrayObject()->set(i, values[i]);
+        uint32_t len = asESArrayObject()->length();
+        ESValueVectorStd values;
+        values.reserve(len);
+        uint32_t undefinedCount = 0;
+        for (uint32_t i = 0; i < len; i++) {
+            const ESValue& v = asESArrayObject()->data()[i];
+            if (v.isUndefined())
+                undefinedCount++;
+            else if (!v.isEmpty())
+                values.push_back(v);
+        }
+        sortValues(values);
+        // sorted values, then undefined, then holes
+        if (asESArrayObject()->isFastmode() && asESArrayObject()->length() == len) {
+            ESValue* data = asESArrayObject()->data();
+            std::copy(values.begin(), values.end(), data);
+            std::fill(data + values.size(), data + values.size() + undefinedCount, ESValue());
+            std::fill(data + values.size() + undefinedCount, data + len, ESValue(ESValue::ESEmptyValue));
+        } else {
+            // the comparator changed the array
+            for (uint32_t i = 0; i < len; i++) {
+                if (i < values.size())
+                    asESArrayObject()->set(i, values[i]);
+                else if (i < values.size() + undefinedCount)
+                    asESArrayObject()->set(i, ESValue());
+                else
+                    asESArrayObject()->set(i, ESValue(ESValue::ESEmptyValue));
+            }
+        }
     } else {
         uint32_t len = get(strings->length.string()).toUint32();
         // TODO : Should separate sparse and compact array later
         ESValueVectorStd selected;
         uint32_t n = 0;
         uint32_t k = 0;
+        uint32_t undefinedCount = 0;
 
         while (k < len) {
             ESValue idx = ESValue(k);
             if (hasProperty(idx)) {
-                selected.push_back(get(idx));
+                ESValue v = get(idx);
+                if (v.isUndefined())
+                    undefinedCount++;
+                else
+                    selected.push_back(v);
                 n++;
                 k++;
             } else {
                 k = ESArrayObject::nextIndexForward(this, k, len, false);
             }
         }
-        std::sort(selected.begin(), selected.end(), c);
+        sortValues(selected);
         uint32_t i;
         for (i = 0; i < n; i++) {
-            if (!set(ESValue(i), selected[i]))
+            if (!set(ESValue(i), i < selected.size() ? selected[i] : ESValue()))
                 ESVMInstance::currentInstance()->throwError(TypeError::create(ESString::create("Attempted to assign to readonly property.")));
 
         }
@@ -2195,6 +2255,77 @@ inline ESTypedArrayObject<Float64Adaptor>::ESTypedArrayObject(TypedArrayType arr
     (Type)(Type::ESObject | Type::ESTypedArrayObject), ESVMInstance::currentInstance()->globalObject()->float64ArrayPrototype())
 {
 }
+
+ALWAYS_INLINE ESValue ESTypedArrayObjectWrapper::get(uint32_t key)
+{
+    if (UNLIKELY(key >= m_arraylength))
+        return ESValue();
+    void* data = rawData();
+    switch (m_arraytype) {
+    case TypedArrayType::Int8Array:
+        return ESValue(static_cast<int8_t*>(data)[key]);
+    case TypedArrayType::Uint8Array:
+    case TypedArrayType::Uint8ClampedArray:
+        return ESValue(static_cast<uint8_t*>(data)[key]);
+    case TypedArrayType::Int16Array:
+        return ESValue(static_cast<int16_t*>(data)[key]);
+    case TypedArrayType::Uint16Array:
+        return ESValue(static_cast<uint16_t*>(data)[key]);
+    case TypedArrayType::Int32Array:
+        return ESValue(static_cast<int32_t*>(data)[key]);
+    case TypedArrayType::Uint32Array:
+        return ESValue(static_cast<uint32_t*>(data)[key]);
+    case TypedArrayType::Float32Array:
+        return ESValue(static_cast<float*>(data)[key]);
+    case TypedArrayType::Float64Array:
+        return ESValue(static_cast<double*>(data)[key]);
+    }
+    RELEASE_ASSERT_NOT_REACHED();
+}
+
+template<typename TypeAdaptor>
+ALWAYS_INLINE void storeTypedArrayElement(void* data, uint32_t key, const ESValue& val)
+{
+    typename TypeAdaptor::Type native = TypeAdaptor::toNative(val);
+    static_cast<typename TypeAdaptor::Type*>(data)[key] = native;
+}
+
+ALWAYS_INLINE bool ESTypedArrayObjectWrapper::set(uint32_t key, ESValue val)
+{
+    if (UNLIKELY(key >= m_arraylength))
+        return false;
+    void* data = rawData();
+    switch (m_arraytype) {
+    case TypedArrayType::Int8Array:
+        storeTypedArrayElement<Int8Adaptor>(data, key, val);
+        return true;
+    case TypedArrayType::Uint8Array:
+        storeTypedArrayElement<Uint8Adaptor>(data, key, val);
+        return true;
+    case TypedArrayType::Uint8ClampedArray:
+        storeTypedArrayElement<Uint8ClampedAdaptor>(data, key, val);
+        return true;
+    case TypedArrayType::Int16Array:
+        storeTypedArrayElement<Int16Adaptor>(data, key, val);
+        return true;
+    case TypedArrayType::Uint16Array:
+        storeTypedArrayElement<Uint16Adaptor>(data, key, val);
+        return true;
+    case TypedArrayType::Int32Array:
+        storeTypedArrayElement<Int32Adaptor>(data, key, val);
+        return true;
+    case TypedArrayType::Uint32Array:
+        storeTypedArrayElement<Uint32Adaptor>(data, key, val);
+        return true;
+    case TypedArrayType::Float32Array:
+        storeTypedArrayElement<Float32Adaptor>(data, key, val);
+        return true;
+    case TypedArrayType::Float64Array:
+        storeTypedArrayElement<Float64Adaptor>(data, key, val);
+        return true;
+    }
+    RELEASE_ASSERT_NOT_REACHED();
+}
 #endif
 
 #define ESStringBuilderInlineStorageMax 12
@@ -2287,34 +2418,35 @@ public:
             return ESString::create(std::move(ret));
         } else {
             UTF16String ret;
-            ret.reserve(m_contentLength);
+            ret.resize(m_contentLength);
 
+            size_t currentLength = 0;
             for (size_t i = 0; i < m_piecesInlineStorageUsage; i ++) {
-                const ESString* data = m_piecesInlineStorage[i].m_string;
-                if (data->isASCIIString()) {
-                    const ASCIIString& str = *data->asASCIIString();
-                    ret.append(&str[m_piecesInlineStorage[i].m_start], &str[m_piecesInlineStorage[i].m_end]);
-                } else {
-                    const UTF16String& str = *data->asUTF16String();
-                    ret.append(&str[m_piecesInlineStorage[i].m_start], &str[m_piecesInlineStorage[i].m_end]);
-                }
+                appendPieceTo(m_piecesInlineStorage[i], &ret[0], currentLength);
             }
 
             for (size_t i = 0; i < m_pieces.size(); i ++) {
-                const ESString* data = m_pieces[i].m_string;
-                if (data->isASCIIString()) {
-                    const ASCIIString& str = *data->asASCIIString();
-                    ret.append(&str[m_pieces[i].m_start], &str[m_pieces[i].m_end]);
-                } else {
-                    const UTF16String& str = *data->asUTF16String();
-                    ret.append(&str[m_pieces[i].m_start], &str[m_pieces[i].m_end]);
-                }
+                appendPieceTo(m_pieces[i], &ret[0], currentLength);
             }
 
             return ESString::create(std::move(ret));
         }
     }
 
+protected:
+    static void appendPieceTo(const ESStringBuilderPiece& piece, char16_t* buffer, size_t& currentLength)
+    {
+        const ESString* data = piece.m_string;
+        size_t s = piece.m_start;
+        size_t e = piece.m_end;
+        if (data->isASCIIString()) {
+            widenASCII(data->asASCIIString()->data() + s, e - s, buffer + currentLength);
+        } else {
+            memcpy(buffer + currentLength, data->asUTF16String()->data() + s, (e - s) * sizeof(char16_t));
+        }
+        currentLength += e - s;
+    }
+
 protected:
     ESStringBuilderPiece m_piecesInlineStorage[ESStringBuilderInlineStorageMax];
     size_t m_piecesInlineStorageUsage;
@@ -2342,14 +2474,35 @@ inline ESString* ESString::concatTwoStrings(ESString* lstr, ESString* rstr)
     }
 }
 
+inline ESString* ESString::appendTwoStrings(ESString* lstr, ESString* rstr)
+{
+    // ropes come out of earlier concatenations, so lstr is a string being built up
+    if (lstr->isESRopeString() && rstr->length())
+        return ESRopeString::createAndAppend(lstr->asESRopeString(), rstr);
+    return concatTwoStrings(lstr, rstr);
+}
+
 inline ESString* ESRopeString::string()
 {
     ASSERT(isESRopeString());
     if (m_content) {
         return m_content;
     }
+    if (m_appendBuffer) {
+        // keep m_appendBuffer, so this rope can still grow the buffer in place
+        ESStringAppendBuffer* buffer = m_appendBuffer;
+        if (m_hasNonASCIIString) {
+            ASSERT(!buffer->m_isASCIIString);
+            m_content = ESString::create(std::move(UTF16String(buffer->m_utf16Buffer.data(), m_contentLength)));
+        } else if (buffer->m_isASCIIString) {
+            m_content = ESString::create(std::move(ASCIIString(buffer->m_asciiBuffer.data(), m_contentLength)));
+        } else {
+            m_content = ESString::create(utf16StringToASCIIString(buffer->m_utf16Buffer.data(), m_contentLength));
+        }
+        return m_content;
+    }
     if (m_hasNonASCIIString) {
-        if (m_contentLength > escargot::options::NativeHeapUsageThreshold) {
+        if (m_contentLength > ESVMInstance::currentInstance()->memoryLimits().m_nativeHeapHardLimit) {
             ESVMInstance::currentInstance()->throwOOMError();
         }
         UTF16String result;
@@ -2362,7 +2515,7 @@ inline ESString* ESRopeString::string()
         while (!queue.empty()) {
             ESString* cur = queue.back();
             queue.pop_back();
-            if (cur->isESRopeString() && (cur->asESRopeString()->m_content == nullptr)) {
+            if (cur->isESRopeString() && cur->asESRopeString()->m_content == nullptr && cur->asESRopeString()->m_appendBuffer == nullptr) {
                 ESRopeString* rs = cur->asESRopeString();
                 ASSERT(rs->m_left);
                 ASSERT(rs->m_right);
@@ -2371,13 +2524,14 @@ inline ESString* ESRopeString::string()
             } else {
                 ESString* str = cur;
                 if (cur->isESRopeString()) {
-                    str = cur->asESRopeString()->m_content;
+                    str = cur->asESRopeString()->string();
                 }
                 pos -= str->length();
                 char16_t* buf = const_cast<char16_t *>(result.data());
-                for (size_t i = 0 ; i < str->length() ; i ++) {
-                    buf[i + pos] = str->charAt(i);
-                }
+                if (str->isASCIIString())
+                    widenASCII(str->asciiData(), str->length(), buf + pos);
+                else
+                    memcpy(buf + pos, str->utf16Data(), str->length() * sizeof(char16_t));
             }
         }
         m_content =  ESString::create(std::move(result));
@@ -2395,7 +2549,7 @@ inline ESString* ESRopeString::string()
         while (!queue.empty()) {
             ESString* cur = queue.back();
             queue.pop_back();
-            if (cur->isESRopeString() && cur->asESRopeString()->m_content == nullptr) {
+            if (cur->isESRopeString() && cur->asESRopeString()->m_content == nullptr && cur->asESRopeString()->m_appendBuffer == nullptr) {
                 ESRopeString* rs = cur->asESRopeString();
                 ASSERT(rs->m_left);
                 ASSERT(rs->m_right);
@@ -2404,7 +2558,7 @@ inline ESString* ESRopeString::string()
             } else {
                 ESString* str = cur;
                 if (cur->isESRopeString()) {
-                    str = cur->asESRopeString()->m_content;
+                    str = cur->asESRopeString()->string();
                 }
                 ASSERT(str->isASCIIString());
                 pos -= str->length();
@@ -28,6 +28,7 @@ public:
     ALWAYS_INLINE ExecutionContext(LexicalEnvironment* varEnv, bool isNewExpression, bool isStrictMode,
         ESValue* callStackInformation, ESValue* arguments = NULL, size_t argumentsCount = 0)
             : m_environment(varEnv)
+            , m_callerContext(NULL)
             , m_callStackInformation((CallStackInformation*)callStackInformation)
             , m_tryOrCatchBodyResult(ESValue::ESForceUninitialized)
     {
@@ -87,6 +88,10 @@ public:
         return m_callStackInformation->m_callee;
     }
 
+    // the context of the caller for a function call, NULL for global and eval code
+    ExecutionContext* callerContext() { return m_callerContext; }
+    void setCallerContext(ExecutionContext* ec) { m_callerContext = ec; }
+
     // http://www.ecma-international.org/ecma-262/6.0/index.html#sec-getthisenvironment
     LexicalEnvironment* getThisEnvironment();
 
@@ -137,6 +142,7 @@ private:
     // LexicalEnvironment* m_lexicalEnvironment;
     // LexicalEnvironment* m_variableEnvironment;
     LexicalEnvironment* m_environment;
+    ExecutionContext* m_callerContext;
 
     struct CallStackInformation {
         ESValue m_thisValue;
@@ -30,6 +30,9 @@
 #include "parser/ScriptParser.h"
 #include "bytecode/ByteCodeOperations.h"
 #include "runtime/JobQueue.h"
+#include "runtime/JSONParser.h"
+#include "runtime/JSONStringifier.h"
+#include "runtime/StableSort.h"
 
 #include "parser/esprima.h"
 
@@ -41,14 +44,29 @@ GlobalObject::GlobalObject()
 {
     m_flags.m_isGlobalObject = true;
     m_didSomePrototypeObjectDefineIndexedProperty = false;
+    m_codeBlocks = NULL;
+    m_codeBlocksSweptAtGCNumber = 0;
+    m_lazyBuiltinAccessorData = NULL;
+    for (size_t i = 0; i < LazyBuiltinCount; i++)
+        m_isLazyBuiltinInstalled[i] = false;
 }
 
 void GlobalObject::finalize()
 {
-    for (auto block : m_codeBlocks) {
-        block->finalize(m_instance, false);
+    CodeBlockRegistryEntry* entry = m_codeBlocks;
+    while (entry) {
+        CodeBlockRegistryEntry* next = entry->m_next;
+        if (CodeBlock* block = entry->m_codeBlock) {
+#if !defined(ENABLE_ESJIT) && defined(NDEBUG)
+            GC_unregister_disappearing_link((void**)&entry->m_codeBlock);
+#endif
+            block->m_registryEntry = NULL;
+            block->finalize(m_instance, false);
+        }
+        delete entry;
+        entry = next;
     }
-    m_codeBlocks.clear();
+    m_codeBlocks = NULL;
 }
 
 const char* errorMessage_GlobalObject_ThisUndefinedOrNull = "%s: this value is undefined or null";
@@ -234,16 +252,34 @@ void GlobalObject::initGlobalObject()
     installArray();
     installString();
     installError();
-    installDate();
     installMath();
-    installJSON();
     installNumber();
     installBoolean();
-    installRegExp();
+
+    m_lazyBuiltinAccessorData = new ESPropertyAccessorData([](ESObject* self, ESObject* originalObj, ::escargot::ESString* propertyName) -> ESValue {
+        GlobalObject* globalObject = ESVMInstance::currentInstance()->globalObject();
+        globalObject->installLazyBuiltin(propertyName);
+        return globalObject->get(propertyName);
+    }, [](::escargot::ESObject* self, ESObject* originalObj, ::escargot::ESString* propertyName, const ESValue& value) {
+        GlobalObject* globalObject = ESVMInstance::currentInstance()->globalObject();
+        globalObject->installLazyBuiltin(propertyName);
+        globalObject->set(propertyName, value);
+    });
+    defineLazyBuiltin(strings->Date.string(), LazyDate);
+    defineLazyBuiltin(strings->JSON.string(), LazyJSON);
+    defineLazyBuiltin(strings->RegExp.string(), LazyRegExp);
 #ifdef USE_ES6_FEATURE
-    installArrayBuffer();
-    installTypedArray();
-    installPromise();
+    defineLazyBuiltin(strings->ArrayBuffer.string(), LazyArrayBuffer);
+    defineLazyBuiltin(strings->Int8Array.string(), LazyTypedArray);
+    defineLazyBuiltin(strings->Int16Array.string(), LazyTypedArray);
+    defineLazyBuiltin(strings->Int32Array.string(), LazyTypedArray);
+    defineLazyBuiltin(strings->Uint8Array.string(), LazyTypedArray);
+    defineLazyBuiltin(strings->Uint16Array.string(), LazyTypedArray);
+    defineLazyBuiltin(strings->Uint32Array.string(), LazyTypedArray);
+    defineLazyBuiltin(strings->Uint8ClampedArray.string(), LazyTypedArray);
+    defineLazyBuiltin(strings->Float32Array.string(), LazyTypedArray);
+    defineLazyBuiltin(strings->Float64Array.string(), LazyTypedArray);
+    defineLazyBuiltin(strings->Promise.string(), LazyPromise);
 #endif
 
     // Value Properties of the Global Object
@@ -1066,6 +1102,63 @@ void GlobalObject::initGlobalObject()
 }
 
 
+void GlobalObject::defineLazyBuiltin(escargot::ESString* name, LazyBuiltin builtin)
+{
+    m_lazyBuiltinNames.push_back(std::make_pair(name, builtin));
+    defineAccessorProperty(name, m_lazyBuiltinAccessorData, true, false, true);
+}
+
+void GlobalObject::defineBuiltinGlobal(escargot::ESString* name, escargot::ESObject* builtin)
+{
+    size_t idx = m_hiddenClass->findProperty(name);
+    if (idx == SIZE_MAX || m_hiddenClass->propertyInfo(idx).isDataProperty() || accessorData(idx) != m_lazyBuiltinAccessorData)
+        return;
+    defineDataProperty(name, true, false, true, builtin);
+}
+
+void GlobalObject::installLazyBuiltin(escargot::ESString* name)
+{
+    for (auto& entry : m_lazyBuiltinNames) {
+        if (*entry.first == *name) {
+            installLazyBuiltin(entry.second);
+            return;
+        }
+    }
+}
+
+void GlobalObject::installLazyBuiltin(LazyBuiltin builtin)
+{
+    // set first: constructing the prototype object asks for the prototype again
+    if (m_isLazyBuiltinInstalled[builtin])
+        return;
+    m_isLazyBuiltinInstalled[builtin] = true;
+
+    switch (builtin) {
+    case LazyJSON:
+        installJSON();
+        break;
+    case LazyDate:
+        installDate();
+        break;
+    case LazyRegExp:
+        installRegExp();
+        break;
+#ifdef USE_ES6_FEATURE
+    case LazyArrayBuffer:
+        installArrayBuffer();
+        break;
+    case LazyTypedArray:
+        installTypedArray();
+        break;
+    case LazyPromise:
+        installPromise();
+        break;
+#endif
+    default:
+        RELEASE_ASSERT_NOT_REACHED();
+    }
+}
+
 void GlobalObject::installFunction()
 {
     // $19.2.1 Function Constructor
@@ -1805,6 +1898,129 @@ void GlobalObject::installError()
     defineDataProperty(strings->EvalError, true, false, true, m_evalError);
 }
 
+// The elements of a fast mode array can be used in m_vector directly.
+// isFastmode() turns false once some prototype object defines an indexed property,
+// so while it holds, a hole (an empty value) is absent and reads as undefined.
+// Builtins which call user code must check again after every call.
+static ESArrayObject* fastModeArray(ESObject* O)
+{
+    if (O->isESArrayObject() && O->asESArrayObject()->isFastmode())
+        return O->asESArrayObject();
+    return nullptr;
+}
+
+template <typename Predicate>
+static ALWAYS_INLINE int64_t scanArrayElements(const ESValue* elements, int64_t k, int64_t end, int64_t step, const Predicate& matches)
+{
+    for (; k != end; k += step) {
+        if (matches(elements[k]))
+            return k;
+    }
+    return -1;
+}
+
+// The first of elements[k], elements[k + step], ... (stopping at end) which is strictly equal
+// to searchElement as in ESValue::equalsTo, or -1. Holes never match.
+static int64_t findStrictlyEqualElement(const ESValue* elements, int64_t k, int64_t end, int64_t step, const ESValue& searchElement)
+{
+    if (searchElement.isNumber()) {
+        double number = searchElement.asNumber();
+        if (std::isnan(number))
+            return -1;
+        return scanArrayElements(elements, k, end, step, [number](const ESValue& e) {
+            return e.isNumber() && e.asNumber() == number;
+        });
+    }
+    if (searchElement.isESString()) {
+        escargot::ESString* string = searchElement.asESString();
+        return scanArrayElements(elements, k, end, step, [string](const ESValue& e) {
+            return !e.isEmpty() && e.isESString() && *e.asESString() == *string;
+        });
+    }
+    // undefined, null, booleans and objects are only equal to the same encoding
+    uint64_t bits = searchElement.asRawData();
+    return scanArrayElements(elements, k, end, step, [bits](const ESValue& e) {
+        return e.asRawData() == bits;
+    });
+}
+
+static const uint32_t powersOfTen[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+static unsigned decimalDigitCount(uint32_t n)
+{
+    unsigned count = 1;
+    while (count < 10 && n >= powersOfTen[count])
+        count++;
+    return count;
+}
+
+// a < b comparing their decimal strings, as the default comparator of sort does, without creating them
+static bool int32LessThanAsString(int32_t a, int32_t b)
+{
+    // '-' sorts before every digit
+    if ((a < 0) != (b < 0))
+        return a < 0;
+    uint32_t x = a < 0 ? -(int64_t)a : a;
+    uint32_t y = b < 0 ? -(int64_t)b : b;
+    unsigned xDigits = decimalDigitCount(x);
+    unsigned yDigits = decimalDigitCount(y);
+    // compare as if the shorter one were padded with zeros
+    uint64_t paddedX = x;
+    uint64_t paddedY = y;
+    if (xDigits < yDigits)
+        paddedX *= powersOfTen[yDigits - xDigits];
+    else
+        paddedY *= powersOfTen[xDigits - yDigits];
+    if (paddedX != paddedY)
+        return paddedX < paddedY;
+    // one is a prefix of the other
+    return xDigits < yDigits;
+}
+
+struct SortStringKey {
+    escargot::ESString* m_key;
+    ESValue m_value;
+};
+
+// sort with no comparefn. Every value is converted to a string once instead of on every comparison,
+// and int32 values are compared without being converted at all
+static void sortByStringValue(ESValueVectorStd& values)
+{
+    bool allInt32 = true;
+    for (size_t i = 0; i < values.size() && allInt32; i ++)
+        allInt32 = values[i].isInt32();
+    if (allInt32) {
+        stableSort(values.data(), values.size(), [](const ESValue& a, const ESValue& b) -> bool {
+            return int32LessThanAsString(a.asInt32(), b.asInt32());
+        });
+        return;
+    }
+
+    std::vector<SortStringKey, gc_allocator<SortStringKey> > keys;
+    keys.reserve(values.size());
+    for (size_t i = 0; i < values.size(); i ++)
+        keys.push_back(SortStringKey { values[i].toString(), values[i] });
+    stableSort(keys.data(), keys.size(), [](const SortStringKey& a, const SortStringKey& b) -> bool {
+        return *a.m_key < *b.m_key;
+    });
+    for (size_t i = 0; i < values.size(); i ++)
+        values[i] = keys[i].m_value;
+}
+
+static void sortWithCompareFunction(ESVMInstance* instance, const ESValue& cmpfn, ESValueVectorStd& values)
+{
+    // one argument buffer for every call
+    ESValue arguments[2];
+    stableSort(values.data(), values.size(), [instance, &cmpfn, &arguments](const ESValue& a, const ESValue& b) -> bool {
+        arguments[0] = a;
+        arguments[1] = b;
+        ESValue ret = ESFunctionObject::call(instance, cmpfn, ESValue(), arguments, 2, false);
+        if (ret.isInt32())
+            return ret.asInt32() < 0;
+        return ret.toNumber() < 0;
+    });
+}
+
 void GlobalObject::installArray()
 {
     m_arrayPrototype = ESArrayObject::create(0);
@@ -1881,6 +2097,14 @@ void GlobalObject::installArray()
                 escargot::ESArrayObject* arr = argi.asESPointer()->asESArrayObject();
                 uint32_t len = arr->length();
 
+                if (ret->isFastmode() && arr->isFastmode() && !ret->shouldConvertToSlowMode(n + len)) {
+                    // holes are copied as holes
+                    ret->setLength(n + len);
+                    std::copy(arr->data(), arr->data() + len, ret->data() + n);
+                    n += len;
+                    continue;
+                }
+
                 while (curIndex < len) {
                     if (arr->hasProperty(ESValue(curIndex))) {
                         ret->defineDataProperty(ESValue(n + curIndex), true, true, true, arr->get(curIndex));
@@ -2055,7 +2279,20 @@ void GlobalObject::installArray()
 
         // Let k be 0.
         size_t k = 0;
+        escargot::ESArrayObject* arr = fastModeArray(O);
         while (k < len) {
+            if (arr && arr->isFastmode()) {
+                // elements past the current length are absent, and no more calls can change that
+                if (k >= arr->length())
+                    break;
+                ESValue kValue = arr->data()[k];
+                if (!kValue.isEmpty()) {
+                    ESValue arguments[3] = {kValue, ESValue(k), O};
+                    ESFunctionObject::call(instance, callbackfn, T, arguments, 3, false);
+                }
+                k++;
+                continue;
+            }
             // Let Pk be ToString(k).
             ESValue pk(k);
             // Let kPresent be HasProperty(O, Pk).
@@ -2099,6 +2336,15 @@ void GlobalObject::installArray()
                     k = tmpk;
             }
 
+            // fromIndex.toInteger() may have changed the array
+            if (escargot::ESArrayObject* arr = fastModeArray(thisBinded)) {
+                int64_t end = std::min(len, arr->length());
+                if (k >= end)
+                    return ESValue(-1);
+                int64_t found = findStrictlyEqualElement(arr->data(), k, end, 1, searchElement);
+                return found == -1 ? ESValue(-1) : ESValue((uint32_t)found);
+            }
+
             while (k < len) {
                 bool kPresent = thisBinded->hasProperty(ESValue(k));
                 if (kPresent) {
@@ -2138,6 +2384,20 @@ void GlobalObject::installArray()
         ESStringBuilder builder;
         double prevIndex = 0;
         double curIndex = 0;
+        // toString of an element may change the array, which is then joined by the loop below
+        escargot::ESArrayObject* arr = fastModeArray(thisBinded);
+        while (arr && curIndex < len && arr->isFastmode()) {
+            uint32_t k = curIndex;
+            if (k != 0 && sep->length() > 0)
+                builder.appendString(sep);
+            if (k < arr->length()) {
+                ESValue elem = arr->data()[k];
+                if (!elem.isEmpty() && !elem.isUndefinedOrNull())
+                    builder.appendString(elem.toString());
+            }
+            prevIndex = curIndex;
+            curIndex++;
+        }
         while (curIndex < len) {
             if (curIndex != 0) {
                 if (sep->length() > 0) {
@@ -2207,6 +2467,15 @@ void GlobalObject::installArray()
                 k = len + n;
             }
 
+            if (escargot::ESArrayObject* arr = fastModeArray(thisBinded)) {
+                if (k >= arr->length())
+                    k = (double)arr->length() - 1;
+                if (k < 0)
+                    return ESValue(-1);
+                int64_t found = findStrictlyEqualElement(arr->data(), k, -1, -1, searchElement);
+                return found == -1 ? ESValue(-1) : ESValue((uint32_t)found);
+            }
+
             while (k >= 0) {
                 bool kPresent = thisBinded->hasProperty(ESValue(k));
                 if (kPresent) {
@@ -2248,7 +2517,21 @@ void GlobalObject::installArray()
         // Let k be 0.
         uint32_t k = 0;
 
+        escargot::ESArrayObject* arr = fastModeArray(O);
         while (k < len) {
+            if (arr && arr->isFastmode() && A->isFastmode()) {
+                if (k >= arr->length())
+                    break;
+                ESValue kValue = arr->data()[k];
+                if (!kValue.isEmpty()) {
+                    ESValue args[] = {kValue, ESValue(k), O};
+                    ESValue mappedValue = ESFunctionObject::call(instance, callbackfn, T, args, 3, false);
+                    A->data()[k] = mappedValue;
+                }
+                k++;
+                continue;
+            }
+
             // Let Pk be ToString(k).
             ESValue pk(k);
 
@@ -2419,6 +2702,12 @@ void GlobalObject::installArray()
     m_arrayPrototype->ESObject::defineDataProperty(strings->reverse, true, false, true, ESFunctionObject::create(NULL, [](ESVMInstance* instance)->ESValue {
         RESOLVE_THIS_BINDING_TO_OBJECT(O, Array, reverse);
         unsigned len = O->length();
+        escargot::ESArrayObject* arr = fastModeArray(O);
+        if (arr && arr->isExtensible()) {
+            // holes move like elements, as the deletes below would
+            std::reverse(arr->data(), arr->data() + len);
+            return O;
+        }
         unsigned middle = std::floor(len / 2);
         unsigned lower = 0;
         while (middle > lower) {
@@ -2506,6 +2795,19 @@ void GlobalObject::installArray()
         }
         uint32_t n = 0;
         escargot::ESArrayObject* ret = ESArrayObject::create();
+        escargot::ESArrayObject* arr = fastModeArray(thisBinded);
+        if (arr && ret->isFastmode()) {
+            // the arguments may have shrunk the array; the length of ret ends at its last present element
+            const ESValue* elements = arr->data();
+            uint32_t end = std::min(finalEnd, arr->length());
+            while (end > k && elements[end - 1].isEmpty())
+                end--;
+            if (end > k) {
+                ret->setLength(end - k);
+                std::copy(elements + k, elements + end, ret->data());
+            }
+            return ret;
+        }
         while (k < finalEnd) {
             bool kPresent = thisBinded->hasProperty(ESValue(k));
             if (kPresent) {
@@ -2585,27 +2887,12 @@ void GlobalObject::installArray()
         bool defaultSort = (arglen == 0)
             || cmpfn.isUndefined();
 
-        thisO->sort([defaultSort, &cmpfn, &instance, &thisO] (
-            const ::escargot::ESValue& a,
-            const ::escargot::ESValue& b) -> bool {
-            if (a.isEmpty() && b.isUndefined())
-                return false;
-            if (a.isUndefined() && b.isEmpty())
-                return true;
-            if (a.isEmpty() || a.isUndefined())
-                return false;
-            if (b.isEmpty() || b.isUndefined())
-                return true;
-            ESValue arg[2] = { a, b };
-            if (defaultSort) {
-                ::escargot::ESString* vala = a.toString();
-                ::escargot::ESString* valb = b.toString();
-                return *vala < *valb;
-            } else {
-                ESValue ret = ESFunctionObject::call(
-                    instance, cmpfn, ESValue(), arg, 2, false);
-                return (ret.toNumber() < 0);
-            } });
+        thisO->sort([defaultSort, &cmpfn, &instance] (ESValueVectorStd& values) {
+            if (defaultSort)
+                sortByStringValue(values);
+            else
+                sortWithCompareFunction(instance, cmpfn, values);
+        });
         return thisO;
     }, strings->sort, 1));
 
@@ -2632,6 +2919,34 @@ void GlobalObject::installArray()
 
         escargot::ESArrayObject* ret = ESArrayObject::create(0);
 
+        // the arguments may have changed the array
+        escargot::ESArrayObject* arr = fastModeArray(thisBinded);
+        if (arr && arr->length() == arrlen && arr->isExtensible() && ret->isFastmode()
+            && !arr->shouldConvertToSlowMode(arrlen - deleteCnt + insertCnt)) {
+            // as below, the length of ret ends at its last present element
+            size_t retLength = deleteCnt;
+            while (retLength && arr->data()[start + retLength - 1].isEmpty())
+                retLength--;
+            if (retLength) {
+                ret->setLength(retLength);
+                std::copy(arr->data() + start, arr->data() + start + retLength, ret->data());
+            }
+
+            size_t newLength = arrlen - deleteCnt + insertCnt;
+            if (insertCnt > deleteCnt) {
+                arr->setLength(newLength);
+                ESValue* elements = arr->data();
+                std::copy_backward(elements + start + deleteCnt, elements + arrlen, elements + newLength);
+            } else if (insertCnt < deleteCnt) {
+                ESValue* elements = arr->data();
+                std::copy(elements + start + deleteCnt, elements + arrlen, elements + start + insertCnt);
+                arr->setLength(newLength);
+            }
+            for (size_t i = 0; i < insertCnt; i ++)
+                arr->data()[start + i] = instance->currentExecutionContext()->readArgument(i + 2);
+            return ret;
+        }
+
         k = start;
         while (k < static_cast<double>(static_cast<double>(deleteCnt) + start)) {
             ESValue from = ESValue(k);
@@ -2762,6 +3077,95 @@ void GlobalObject::installArray()
     defineDataProperty(strings->Array, true, false, true, m_array);
 }
 
+// A replaceValue of String.prototype.replace, split once into literal runs and $ substitutions
+// so every match is expanded by appending pieces to a builder.
+struct ReplacementTemplatePart {
+    enum Type {
+        Literal, // m_start..m_end of the template
+        Matched, // $&
+        Prefix, // $`
+        Suffix, // $'
+        Capture, // $n or $nn, m_start is the group
+    };
+    Type m_type;
+    unsigned m_start;
+    unsigned m_end;
+};
+
+typedef std::vector<ReplacementTemplatePart, pointer_free_allocator<ReplacementTemplatePart> > ReplacementTemplate;
+
+static void appendReplacementLiteral(ReplacementTemplate& parts, unsigned start, unsigned end)
+{
+    if (parts.size() && parts.back().m_type == ReplacementTemplatePart::Literal && parts.back().m_end == start) {
+        parts.back().m_end = end;
+        return;
+    }
+    parts.push_back(ReplacementTemplatePart { ReplacementTemplatePart::Literal, start, end });
+}
+
+static void parseReplacementTemplate(escargot::ESString* replaceString, unsigned subPatternNum, ReplacementTemplate& parts)
+{
+    size_t length = replaceString->length();
+    for (unsigned j = 0; j < length; j ++) {
+        if (replaceString->charAt(j) != '$' || j + 1 >= length) {
+            appendReplacementLiteral(parts, j, j + 1);
+            continue;
+        }
+        char16_t c = replaceString->charAt(j + 1);
+        if (c == '$') {
+            appendReplacementLiteral(parts, j, j + 1);
+        } else if (c == '&') {
+            parts.push_back(ReplacementTemplatePart { ReplacementTemplatePart::Matched, 0, 0 });
+        } else if (c == '`') {
+            parts.push_back(ReplacementTemplatePart { ReplacementTemplatePart::Prefix, 0, 0 });
+        } else if (c == '\'') {
+            parts.push_back(ReplacementTemplatePart { ReplacementTemplatePart::Suffix, 0, 0 });
+        } else if ('0' <= c && c <= '9') {
+            // two digits are used only if they name an existing group
+            unsigned idx = c - '0';
+            char16_t peek = j + 2 < length ? replaceString->charAt(j + 2) : 0;
+            if ('0' <= peek && peek <= '9' && idx * 10 + (peek - '0') != 0 && idx * 10 + (peek - '0') <= subPatternNum) {
+                parts.push_back(ReplacementTemplatePart { ReplacementTemplatePart::Capture, idx * 10 + (peek - '0'), 0 });
+                j++;
+            } else if (idx != 0 && idx <= subPatternNum) {
+                parts.push_back(ReplacementTemplatePart { ReplacementTemplatePart::Capture, idx, 0 });
+            } else {
+                appendReplacementLiteral(parts, j, j + 2);
+            }
+        } else {
+            appendReplacementLiteral(parts, j, j + 2);
+        }
+        j++;
+    }
+}
+
+// output is a match in the format of ESRegExpObject::matchAt
+static void appendReplacement(ESStringBuilder& builder, escargot::ESString* string, const unsigned* output,
+    escargot::ESString* replaceString, const ReplacementTemplate& parts)
+{
+    for (size_t i = 0; i < parts.size(); i ++) {
+        const ReplacementTemplatePart& part = parts[i];
+        switch (part.m_type) {
+        case ReplacementTemplatePart::Literal:
+            builder.appendSubString(replaceString, part.m_start, part.m_end);
+            break;
+        case ReplacementTemplatePart::Matched:
+            builder.appendSubString(string, output[0], output[1]);
+            break;
+        case ReplacementTemplatePart::Prefix:
+            builder.appendSubString(string, 0, output[0]);
+            break;
+        case ReplacementTemplatePart::Suffix:
+            builder.appendSubString(string, output[1], string->length());
+            break;
+        case ReplacementTemplatePart::Capture:
+            if (output[part.m_start * 2] != (unsigned)-1)
+                builder.appendSubString(string, output[part.m_start * 2], output[part.m_start * 2 + 1]);
+            break;
+        }
+    }
+}
+
 void GlobalObject::installString()
 {
     m_string = ESFunctionObject::create(NULL, [](ESVMInstance* instance)->ESValue {
@@ -2963,20 +3367,33 @@ void GlobalObject::installString()
             regexp->set(strings->lastIndex.string(), ESValue(0), true);
         }
 
+        // https://developer.mozilla.org/en-US/docs/Web/JavaScript/Reference/Global_Objects/String/match
+        // if global flag is on, match method returns an Array containing all matched substrings
+        if (isGlobal) {
+            if (!regexp->compileIfNeeded())
+                return ESValue(ESValue::ESNull);
+            unsigned* output;
+            ALLOCA_WRAPPER(instance, output, unsigned*, sizeof(unsigned) * 2 * (regexp->subPatternNum() + 1), true);
+            escargot::ESArrayObject* ret = nullptr;
+            size_t start = 0;
+            while (regexp->matchAt(thisObject, start, output)) {
+                if (!ret)
+                    ret = ESArrayObject::create();
+                ret->push(thisObject->substring(output[0], output[1]));
+                start = output[1] == output[0] ? output[1] + 1 : output[1];
+            }
+            if (!ret)
+                return ESValue(ESValue::ESNull);
+            return ret;
+        }
+
         RegexMatchResult result;
         bool testResult = regexp->matchNonGlobally(thisObject, result, false, 0);
         if (!testResult) {
             regexp->set(strings->lastIndex, ESValue(0), true);
             return ESValue(ESValue::ESNull);
         }
-
-        // https://developer.mozilla.org/en-US/docs/Web/JavaScript/Reference/Global_Objects/String/match
-        // if global flag is on, match method returns an Array containing all matched substrings
-        if (isGlobal) {
-            return thisObject->createMatchedArray(regexp, result);
-        } else {
-            return regexp->createRegExpMatchedArray(result, thisObject);
-        }
+        return regexp->createRegExpMatchedArray(result, thisObject);
     }, strings->match.string(), 1));
 
     // $21.1.3.14 String.prototype.replace(searchValue, replaceValue)
@@ -2988,156 +3405,91 @@ void GlobalObject::installString()
         bool replaceValueIsFunction = replaceValue.isESPointer() && replaceValue.asESPointer()->isESFunctionObject();
         if (!replaceValueIsFunction)
             replaceString = replaceValue.toString();
-        RegexMatchResult result;
-
+        escargot::ESRegExpObject* regexp = nullptr;
+        bool isGlobal = false;
+        unsigned subPatternNum = 0;
+        // one buffer in the format of ESRegExpObject::matchAt, reused for every match
+        unsigned* output;
         if (searchValue.isESPointer() && searchValue.asESPointer()->isESRegExpObject()) {
-            escargot::ESRegExpObject* regexp = searchValue.asESPointer()->asESRegExpObject();
+            regexp = searchValue.asESPointer()->asESRegExpObject();
             (void)regexp->lastIndex().toInteger();
-            bool isGlobal = regexp->option() & ESRegExpObject::Option::Global;
+            isGlobal = regexp->option() & ESRegExpObject::Option::Global;
 
             if (isGlobal) {
                 regexp->set(strings->lastIndex.string(), ESValue(0), true);
             }
-            bool testResult = regexp->matchNonGlobally(string, result, false, 0);
-            if (testResult) {
-                if (isGlobal) {
-                    string->createRegexMatchResult(regexp, result);
-                }
-            } else {
+            if (!regexp->compileIfNeeded()) {
                 regexp->set(strings->lastIndex.string(), ESValue(0), true);
+                return string;
+            }
+            subPatternNum = regexp->subPatternNum();
+            ALLOCA_WRAPPER(instance, output, unsigned*, sizeof(unsigned) * 2 * (subPatternNum + 1), true);
+            if (!regexp->matchAt(string, 0, output)) {
+                regexp->set(strings->lastIndex.string(), ESValue(0), true);
+                return string;
             }
         } else {
             escargot::ESString* searchString = searchValue.toString();
             size_t idx = string->find(searchString);
-            if (idx != (size_t)-1) {
-                std::vector<RegexMatchResult::RegexMatchResultPiece,
-                    pointer_free_allocator<RegexMatchResult::RegexMatchResultPiece> > piece;
-                RegexMatchResult::RegexMatchResultPiece p;
-                p.m_start = idx;
-                p.m_end = idx + searchString->length();
-                piece.push_back(std::move(p));
-                result.m_matchResults.push_back(std::move(piece));
+            if (idx == (size_t)-1) {
+                return string;
             }
+            ALLOCA_WRAPPER(instance, output, unsigned*, sizeof(unsigned) * 2, true);
+            output[0] = idx;
+            output[1] = idx + searchString->length();
         }
 
-        if (result.m_matchResults.size() == 0) {
-            return string;
-        }
+        auto findNextMatch = [&]() -> bool {
+            if (!isGlobal)
+                return false;
+            size_t start = output[1] == output[0] ? output[1] + 1 : output[1];
+            return regexp->matchAt(string, start, output);
+        };
 
+        ESStringBuilder builder;
         if (replaceValueIsFunction) {
-            uint32_t matchCount = result.m_matchResults.size();
-            ESValue callee = replaceValue.asESPointer()->asESFunctionObject();
-
-            ESStringBuilder builer;
-            builer.appendSubString(string, 0, result.m_matchResults[0][0].m_start);
+            // every match is found before the replacer runs, as in the spec
+            size_t outputSize = 2 * (subPatternNum + 1);
+            std::vector<unsigned, pointer_free_allocator<unsigned> > matches;
+            do {
+                matches.insert(matches.end(), output, output + outputSize);
+            } while (findNextMatch());
 
-            for (uint32_t i = 0; i < matchCount ; i ++) {
-                int subLen = result.m_matchResults[i].size();
-                ESValue* arguments;
-                ALLOCA_WRAPPER(instance, arguments, ESValue*, sizeof(ESValue) * (subLen + 2), false);
-                for (unsigned j = 0; j < (unsigned)subLen ; j ++) {
-                    if (result.m_matchResults[i][j].m_start == std::numeric_limits<unsigned>::max())
+            ESValue callee = replaceValue.asESPointer()->asESFunctionObject();
+            ESValue* arguments;
+            ALLOCA_WRAPPER(instance, arguments, ESValue*, sizeof(ESValue) * (subPatternNum + 3), false);
+            size_t lastEnd = 0;
+            for (size_t i = 0; i < matches.size(); i += outputSize) {
+                const unsigned* match = &matches[i];
+                builder.appendSubString(string, lastEnd, match[0]);
+                for (unsigned j = 0; j < subPatternNum + 1; j ++) {
+                    if (match[j * 2] == (unsigned)-1)
                         arguments[j] = ESValue(ESValue::ESUndefined);
-                    else {
-                        ESStringBuilder argStrBuilder;
-                        argStrBuilder.appendSubString(string, result.m_matchResults[i][j].m_start, result.m_matchResults[i][j].m_end);
-                        arguments[j] = argStrBuilder.finalize();
-                    }
+                    else
+                        arguments[j] = string->substring(match[j * 2], match[j * 2 + 1]);
                 }
-                arguments[subLen] = ESValue((int)result.m_matchResults[i][0].m_start);
-                arguments[subLen + 1] = string;
+                arguments[subPatternNum + 1] = ESValue(match[0]);
+                arguments[subPatternNum + 2] = string;
                 // 21.1.3.14 (11) it should be called with this as undefined
-                escargot::ESString* res = ESFunctionObject::call(instance, callee, ESValue(ESValue::ESUndefined), arguments, subLen + 2, false).toString();
-                builer.appendSubString(res, 0, res->length());
-
-                if (i < matchCount - 1) {
-                    builer.appendSubString(string, result.m_matchResults[i][0].m_end, result.m_matchResults[i + 1][0].m_start);
-                }
+                escargot::ESString* res = ESFunctionObject::call(instance, callee, ESValue(ESValue::ESUndefined), arguments, subPatternNum + 3, false).toString();
+                builder.appendString(res);
+                lastEnd = match[1];
             }
-            builer.appendSubString(string, result.m_matchResults[matchCount - 1][0].m_end, string->length());
-            escargot::ESString* resultString = builer.finalize();
-            return resultString;
+            builder.appendSubString(string, lastEnd, string->length());
         } else {
             ASSERT(replaceString);
+            ReplacementTemplate parts;
+            parseReplacementTemplate(replaceString, subPatternNum, parts);
 
-            bool hasDollar = false;
-            for (size_t i = 0; i < replaceString->length() ; i ++) {
-                if (replaceString->charAt(i) == '$') {
-                    hasDollar = true;
-                    break;
-                }
-            }
-
-            ESStringBuilder builder;
-            if (!hasDollar) {
-                // flat replace
-                int32_t matchCount = result.m_matchResults.size();
-                builder.appendSubString(string, 0, result.m_matchResults[0][0].m_start);
-                for (int32_t i = 0; i < matchCount ; i ++) {
-                    escargot::ESString* res = replaceString;
-                    builder.appendString(res);
-                    if (i < matchCount - 1) {
-                        builder.appendSubString(string, result.m_matchResults[i][0].m_end, result.m_matchResults[i + 1][0].m_start);
-                    }
-                }
-                builder.appendSubString(string, result.m_matchResults[matchCount - 1][0].m_end, string->length());
-            } else {
-                // dollar replace
-                int32_t matchCount = result.m_matchResults.size();
-                builder.appendSubString(string, 0, result.m_matchResults[0][0].m_start);
-                for (int32_t i = 0; i < matchCount ; i ++) {
-                    for (unsigned j = 0; j < replaceString->length() ; j ++) {
-                        if (replaceString->charAt(j) == '$' && (j + 1) < replaceString->length()) {
-                            char16_t c = replaceString->charAt(j + 1);
-                            if (c == '$') {
-                                builder.appendChar(replaceString->charAt(j));
-                            } else if (c == '&') {
-                                builder.appendSubString(string, result.m_matchResults[i][0].m_start, result.m_matchResults[i][0].m_end);
-                            } else if (c == '\'') {
-                                builder.appendSubString(string, result.m_matchResults[i][0].m_end, string->length());
-                            } else if (c == '`') {
-                                builder.appendSubString(string, 0, result.m_matchResults[i][0].m_start);
-                            } else if ('0' <= c && c <= '9') {
-                                size_t idx = c - '0';
-                                int peek = replaceString->charAt(j + 2) - '0';
-                                bool usePeek = false;
-                                if (0 <= peek && peek <= 9) {
-                                    idx *= 10;
-                                    idx += peek;
-                                    usePeek = true;
-                                }
-
-                                if (idx < result.m_matchResults[i].size() && idx != 0) {
-                                    builder.appendSubString(string, result.m_matchResults[i][idx].m_start, result.m_matchResults[i][idx].m_end);
-                                    if (usePeek)
-                                        j++;
-                                } else {
-                                    idx = c - '0';
-                                    if (idx < result.m_matchResults[i].size() && idx != 0) {
-                                        builder.appendSubString(string, result.m_matchResults[i][idx].m_start, result.m_matchResults[i][idx].m_end);
-                                    } else {
-                                        builder.appendChar('$');
-                                        builder.appendChar(c);
-                                    }
-                                }
-                            } else {
-                                builder.appendChar('$');
-                                builder.appendChar(c);
-                            }
-                            j++;
-                        } else {
-                            builder.appendChar(replaceString->charAt(j));
-                        }
-                    }
-                    if (i < matchCount - 1) {
-                        builder.appendSubString(string, result.m_matchResults[i][0].m_end, result.m_matchResults[i + 1][0].m_start);
-                    }
-                }
-                builder.appendSubString(string, result.m_matchResults[matchCount - 1][0].m_end, string->length());
-            }
-            escargot::ESString* resultString = builder.finalize();
-            return resultString;
+            size_t lastEnd = 0;
+            do {
+                builder.appendSubString(string, lastEnd, output[0]);
+                appendReplacement(builder, string, output, replaceString, parts);
+                lastEnd = output[1];
+            } while (findNextMatch());
+            builder.appendSubString(string, lastEnd, string->length());
         }
+        return builder.finalize();
     }, strings->replace.string(), 2));
 
     // $21.1.3.15 String.prototype.search
@@ -3251,27 +3603,37 @@ void GlobalObject::installString()
         // 13
         if (P->isESRegExpObject()) {
             escargot::ESRegExpObject* R = P->asESRegExpObject();
+            if (!R->compileIfNeeded()) {
+                A->defineDataProperty(ESValue(lengthA++), true, true, true, S);
+                return A;
+            }
+            unsigned subPatternNum = R->subPatternNum();
+            unsigned* output;
+            ALLOCA_WRAPPER(instance, output, unsigned*, sizeof(unsigned) * 2 * (subPatternNum + 1), true);
             while (q != s) {
-                RegexMatchResult result;
-                bool ret = R->matchNonGlobally(S, result, false, (size_t)q);
-                if (!ret) {
+                if (!R->matchAt(S, q, output)) {
                     break;
                 }
 
-                if ((size_t)result.m_matchResults[0][0].m_end == p) {
+                if ((size_t)output[1] == p) {
                     q++;
                 } else {
-                    if (result.m_matchResults[0][0].m_start >= S->length())
+                    if (output[0] >= S->length())
                         break;
 
-                    escargot::ESString* T = S->substring(p, result.m_matchResults[0][0].m_start);
+                    escargot::ESString* T = S->substring(p, output[0]);
                     A->defineDataProperty(ESValue(lengthA++), true, true, true, ESValue(T));
                     if (lengthA == lim)
                         return A;
-                    p = result.m_matchResults[0][0].m_end;
-                    R->pushBackToRegExpMatchedArray(A, lengthA, lim, result, S);
-                    if (lengthA == lim)
-                        return A;
+                    p = output[1];
+                    for (unsigned i = 1; i < subPatternNum + 1; i ++) {
+                        if (output[i * 2] == (unsigned)-1)
+                            A->defineDataProperty(ESValue(lengthA++), true, true, true, ESValue(ESValue::ESUndefined));
+                        else
+                            A->defineDataProperty(ESValue(lengthA++), true, true, true, S->substring(output[i * 2], output[i * 2 + 1]));
+                        if (lengthA == lim)
+                            return A;
+                    }
                     q = p;
                 }
             }
@@ -3342,8 +3704,7 @@ void GlobalObject::installString()
         RESOLVE_THIS_BINDING_TO_STRING(str, String, toLocaleLowerCase);
         if (str->isASCIIString()) {
             ASCIIString newstr(*str->asASCIIString());
-            // TODO use ICU for this operation
-            std::transform(newstr.begin(), newstr.end(), newstr.begin(), ::tolower);
+            asciiToLower(newstr.data(), newstr.length(), &newstr[0]);
             return ESString::create(std::move(newstr));
         } else {
             UTF16String newstr(*str->asUTF16String());
@@ -3358,8 +3719,7 @@ void GlobalObject::installString()
         RESOLVE_THIS_BINDING_TO_STRING(str, String, toLowerCase);
         if (str->isASCIIString()) {
             ASCIIString newstr(*str->asASCIIString());
-            // TODO use ICU for this operation
-            std::transform(newstr.begin(), newstr.end(), newstr.begin(), ::tolower);
+            asciiToLower(newstr.data(), newstr.length(), &newstr[0]);
             return ESString::create(std::move(newstr));
         } else {
             UTF16String newstr(*str->asUTF16String());
@@ -3374,8 +3734,7 @@ void GlobalObject::installString()
         RESOLVE_THIS_BINDING_TO_STRING(str, String, toLocaleUpperCase);
         if (str->isASCIIString()) {
             ASCIIString newstr(*str->asASCIIString());
-            // TODO use ICU for this operation
-            std::transform(newstr.begin(), newstr.end(), newstr.begin(), ::toupper);
+            asciiToUpper(newstr.data(), newstr.length(), &newstr[0]);
             return ESString::create(std::move(newstr));
         } else {
             UTF16String newstr(*str->asUTF16String());
@@ -3390,8 +3749,7 @@ void GlobalObject::installString()
         RESOLVE_THIS_BINDING_TO_STRING(str, String, toUpperCase);
         if (str->isASCIIString()) {
             ASCIIString newstr(*str->asASCIIString());
-            // TODO use ICU for this operation
-            std::transform(newstr.begin(), newstr.end(), newstr.begin(), ::toupper);
+            asciiToUpper(newstr.data(), newstr.length(), &newstr[0]);
             return ESString::create(std::move(newstr));
         } else {
             UTF16String newstr(*str->asUTF16String());
@@ -3500,105 +3858,19 @@ void GlobalObject::installString()
     m_stringObjectProxy->setExtensible(false);
 }
 
-template <typename CharType, typename JSONCharType>
-ESValue parseJSON(ESVMInstance* instance, const CharType* data)
-{
-    rapidjson::GenericDocument<JSONCharType> jsonDocument;
-
-    rapidjson::GenericStringStream<JSONCharType> stringStream(data);
-    jsonDocument.ParseStream(stringStream);
-    if (jsonDocument.HasParseError()) {
-        throwBuiltinError(instance, ErrorCode::SyntaxError, strings->JSON, true, strings->parse, rapidjson::GetParseError_En(jsonDocument.GetParseError()));
-    }
-    // FIXME: JSON.parse treats "__proto__" as a regular property name. (test262: ch15/15.12/15.12.2/S15.12.2_A1.js)
-    //        >>> var x1 = JSON.parse('{"__proto__":[]}') // x1.__proto__ = []
-    //        >>> var x2 = JSON.parse('{"__proto__":1}') // x2.__proto__ = 1
-    //        >>> var y1 = {"__proto__":[]} // y1.__proto__ = []
-    //        >>> var y2 = {"__proto__":1} // y2.__proto__ != 1
-    //        >>> Object.getPrototypeOf(x1) == Object.prototype // true
-    //        >>> Object.getPrototypeOf(x2) == Object.prototype // true
-    //        >>> Object.getPrototypeOf(y1) == Object.prototype // false
-    //        >>> Object.getPrototypeOf(y2) == Object.prototype // true
-    std::function<ESValue(rapidjson::GenericValue<JSONCharType>& value)> fn;
-    fn = [&fn](rapidjson::GenericValue<JSONCharType>& value) -> ESValue {
-        if (value.IsBool()) {
-            return ESValue(value.GetBool());
-        } else if (value.IsInt()) {
-            return ESValue(value.GetInt());
-        } else if (value.IsUint()) {
-            return ESValue(value.GetUint());
-        } else if (value.IsInt64()) {
-            return ESValue(value.GetInt64());
-        } else if (value.IsUint64()) {
-            return ESValue(value.GetUint64());
-        } else if (value.IsDouble()) {
-            return ESValue(value.GetDouble());
-        } else if (value.IsNull()) {
-            return ESValue(ESValue::ESNull);
-        } else if (value.IsString()) {
-            if (std::is_same<CharType, char16_t>::value) {
-                UTF16String str;
-                unsigned len = value.GetStringLength();
-                str.reserve(len);
-                const CharType* chars = value.GetString();
-                for (unsigned i = 0; i < len; i++) {
-                    str.push_back(chars[i]);
-                }
-                return ESString::create(str);
-            } else {
-                const char* valueAsString = (const char*)value.GetString();
-                if (isAllASCII(valueAsString, strlen(valueAsString))) {
-                    return ESString::create(escargot::ASCIIString(valueAsString));
-                } else {
-                    return ESString::create(utf8StringToUTF16String(valueAsString, strlen(valueAsString)));
-                }
-            }
-        } else if (value.IsArray()) {
-            escargot::ESArrayObject* arr = ESArrayObject::create();
-            size_t i = 0;
-            auto iter = value.Begin();
-            while (iter != value.End()) {
-                arr->defineDataProperty(ESValue(i++), true, true, true, fn(*iter));
-                iter++;
-            }
-            return arr;
-        } else if (value.IsObject()) {
-            escargot::ESObject* obj = ESObject::create();
-            auto iter = value.MemberBegin();
-            while (iter != value.MemberEnd()) {
-                ESValue propertyName = fn(iter->name);
-                ASSERT(propertyName.isESString());
-                obj->defineDataProperty(propertyName.asESString(), true, true, true, fn(iter->value), true);
-                iter++;
-            }
-            return obj;
-        } else {
-            RELEASE_ASSERT_NOT_REACHED();
-        }
-    };
-
-    return fn(jsonDocument);
-}
-
 void GlobalObject::installJSON()
 {
     // create JSON object
     m_json = ESJSONObject::create();
     m_json->forceNonVectorHiddenClass(true);
     m_json->set__proto__(m_objectPrototype);
-    defineDataProperty(strings->JSON, true, false, true, m_json);
+    defineBuiltinGlobal(strings->JSON.string(), m_json);
 
     // $24.3.1 JSON.parse(text[, reviver])
     m_json->defineDataProperty(strings->parse, true, false, true, ESFunctionObject::create(NULL, [](ESVMInstance* instance)->ESValue {
         // 1, 2, 3
         escargot::ESString* JText = instance->currentExecutionContext()->readArgument(0).toString();
-        ESValue unfiltered;
-
-        if (JText->isASCIIString()) {
-            unfiltered = parseJSON<char, rapidjson::UTF8<char>>(instance, JText->toNullableUTF8String().m_buffer);
-        } else {
-            unfiltered = parseJSON<char16_t, rapidjson::UTF16<char16_t>>(instance, JText->asUTF16String()->data());
-        }
+        ESValue unfiltered = parseJSON(instance, JText);
 
         // 4
         ESValue reviver = instance->currentExecutionContext()->readArgument(1);
@@ -3734,6 +4006,12 @@ void GlobalObject::installJSON()
             }
         }
 
+        if (!replacerFunc && !propertyListTouched && gap.empty()) {
+            ESValue result;
+            if (stringifyJSONFast(instance, value, result))
+                return result;
+        }
+
         std::function<ESValue(ESValue key, ESObject* holder)> Str;
         std::function<ESValue(ESValue value)> JA;
         std::function<ESValue(ESValue value)> JO;
@@ -4894,7 +5172,7 @@ void GlobalObject::installRegExp()
 #endif
 
     // add regexp to global object
-    defineDataProperty(strings->RegExp, true, false, true, m_regexp);
+    defineBuiltinGlobal(strings->RegExp.string(), m_regexp);
 }
 
 #ifdef USE_ES6_FEATURE
@@ -4989,7 +5267,7 @@ void GlobalObject::installArrayBuffer()
 
     m_arrayBuffer->set__proto__(m_functionPrototype); // empty Function
     m_arrayBuffer->setProtoType(m_arrayBufferPrototype);
-    defineDataProperty(strings->ArrayBuffer, true, false, true, m_arrayBuffer);
+    defineBuiltinGlobal(strings->ArrayBuffer.string(), m_arrayBuffer);
 }
 
 void GlobalObject::installTypedArray()
@@ -5011,6 +5289,18 @@ void GlobalObject::installTypedArray()
     m_Uint32ArrayPrototype = m_Uint32Array->protoType().asESPointer()->asESObject();
     m_Float32ArrayPrototype = m_Float32Array->protoType().asESPointer()->asESObject();
     m_Float64ArrayPrototype = m_Float64Array->protoType().asESPointer()->asESObject();
+    m_Uint8ClampedArrayPrototype = m_Uint8ClampedArray->protoType().asESPointer()->asESObject();
+}
+
+// the relative start and end arguments of the %TypedArray% methods, clamped to [0, length]
+static unsigned typedArrayRelativeIndex(const ESValue& value, unsigned length, unsigned undefinedValue)
+{
+    if (value.isUndefined())
+        return undefinedValue;
+    double relative = value.toInteger();
+    if (relative < 0)
+        return std::max(length + relative, 0.0);
+    return std::min(relative, (double)length);
 }
 
 template <typename T>
@@ -5130,90 +5420,58 @@ ESFunctionObject* GlobalObject::installTypedArray(escargot::ESString* ta_name)
         if (offset < 0)
             throwBuiltinError(instance, ErrorCode::TypeError, strings->TypedArray, true, strings->set, "");
         auto arg0 = instance->currentExecutionContext()->readArgument(0).asESPointer();
-        escargot::ESArrayBufferObject* targetBuffer = wrapper->buffer();
         unsigned targetLength = wrapper->arraylength();
-        int targetByteOffset = wrapper->byteoffset();
-        int targetElementSize = wrapper->elementSize();
         if (!arg0->isESTypedArrayObject()) {
             ESObject* src = arg0->asESObject();
             uint32_t srcLength = (uint32_t)src->get(strings->length.string()).asInt32();
             if (srcLength + (uint32_t)offset > targetLength)
                 throwBuiltinError(instance, ErrorCode::RangeError, strings->TypedArray, true, strings->set, "");
 
-            int targetByteIndex = offset * targetElementSize + targetByteOffset;
-            int k = 0;
-            int limit = targetByteIndex + targetElementSize * srcLength;
-
-            while (targetByteIndex < limit) {
-                escargot::ESString* Pk = ESString::create(k);
-                double kNumber = src->get(Pk).toNumber();
-                wrapper->set(targetByteIndex / targetElementSize, ESValue(kNumber));
-                k++;
-                targetByteIndex += targetElementSize;
+            for (uint32_t k = 0; k < srcLength; k++) {
+                // ToNumber can run user code, which may change the source array
+                escargot::ESArrayObject* fastSrc = fastModeArray(src);
+                ESValue value;
+                if (fastSrc && k < fastSrc->length() && !fastSrc->data()[k].isEmpty())
+                    value = fastSrc->data()[k];
+                else
+                    value = src->get(ESValue(k));
+                wrapper->set(offset + k, ESValue(value.toNumber()));
             }
             return ESValue();
         } else {
             auto arg0Wrapper = arg0->asESTypedArrayObjectWrapper();
-            escargot::ESArrayBufferObject* srcBuffer = arg0Wrapper->buffer();
             unsigned srcLength = arg0Wrapper->arraylength();
-            int srcByteOffset = arg0Wrapper->byteoffset();
             if (srcLength + (unsigned)offset > targetLength)
                 throwBuiltinError(instance, ErrorCode::RangeError, strings->TypedArray, true, strings->set, "");
-            int srcByteIndex = 0;
-            if (srcBuffer == targetBuffer) {
-                // TODO: 24) should clone targetBuffer
-                RELEASE_ASSERT_NOT_REACHED();
+            if (wrapper->arraytype() == arg0Wrapper->arraytype()) {
+                // memmove also covers two views of one buffer
+                unsigned elementSize = wrapper->elementSize();
+                memmove((int8_t*)wrapper->rawData() + offset * elementSize, arg0Wrapper->rawData(), srcLength * elementSize);
+            } else if (wrapper->buffer() == arg0Wrapper->buffer()) {
+                // the source has to be read before any element is overwritten
+                std::vector<ESValue> values(srcLength);
+                for (unsigned i = 0; i < srcLength; i++)
+                    values[i] = arg0Wrapper->get(i);
+                for (unsigned i = 0; i < srcLength; i++)
+                    wrapper->set(offset + i, values[i]);
             } else {
-                srcByteIndex = srcByteOffset;
-            }
-            unsigned targetIndex = (unsigned)offset, srcIndex = 0;
-            unsigned targetByteIndex = offset * targetElementSize + targetByteOffset;
-            unsigned limit = targetByteIndex + targetElementSize * srcLength;
-            if (wrapper->arraytype() != arg0Wrapper->arraytype()) {
-                while (targetIndex < offset + srcLength) {
-                    ESValue value = arg0Wrapper->get(srcIndex);
-                    wrapper->set(targetIndex, value);
-                    srcIndex++;
-                    targetIndex++;
-                }
-            } else {
-                while (targetByteIndex < limit) {
-                    ESValue value = srcBuffer->getValueFromBuffer<uint8_t>(srcByteIndex, escargot::Uint8Array);
-                    targetBuffer->setValueInBuffer<Uint8Adaptor>(targetByteIndex, escargot::Uint8Array, value);
-                    srcByteIndex++;
-                    targetByteIndex++;
-                }
+                for (unsigned i = 0; i < srcLength; i++)
+                    wrapper->set(offset + i, arg0Wrapper->get(i));
             }
             return ESValue();
         }
     }, strings->set));
     // $22.2.3.26 %TypedArray%.prototype.subarray([begin [, end]])
     ta_prototype->ESObject::defineDataProperty(strings->subarray, true, false, true, ESFunctionObject::create(NULL, [](ESVMInstance* instance)->ESValue {
-        size_t arglen = instance->currentExecutionContext()->argumentCount();
         RESOLVE_THIS_BINDING_TO_OBJECT(thisBinded, TypedArray, subarray);
         if (!thisBinded->isESTypedArrayObject())
             throwBuiltinError(instance, ErrorCode::TypeError, strings->TypedArray, true, strings->subarray, errorMessage_GlobalObject_ThisNotTypedArrayObject);
         auto wrapper = thisBinded->asESTypedArrayObjectWrapper();
         escargot::ESArrayBufferObject* buffer = wrapper->buffer();
         unsigned srcLength = wrapper->arraylength();
-        int relativeBegin = 0;
-        unsigned beginIndex;
-        if (arglen >= 1)
-            relativeBegin = instance->currentExecutionContext()->arguments()[0].toInt32();
-        if (relativeBegin < 0)
-            beginIndex = (srcLength + relativeBegin) > 0 ? (srcLength + relativeBegin) : 0;
-        else
-            beginIndex = (unsigned) relativeBegin < srcLength ? relativeBegin : srcLength;
-        unsigned relativeEnd = srcLength, endIndex;
-        if (arglen >= 2)
-            relativeEnd = instance->currentExecutionContext()->arguments()[1].toInt32();
-        if (relativeEnd < 0)
-            endIndex = (srcLength + relativeEnd) > 0 ? (srcLength + relativeEnd) : 0;
-        else
-            endIndex = relativeEnd < srcLength ? relativeEnd : srcLength;
-        unsigned newLength = 0;
-        if (endIndex - beginIndex > 0)
-            newLength = endIndex - beginIndex;
+        unsigned beginIndex = typedArrayRelativeIndex(instance->currentExecutionContext()->readArgument(0), srcLength, 0);
+        unsigned endIndex = typedArrayRelativeIndex(instance->currentExecutionContext()->readArgument(1), srcLength, srcLength);
+        unsigned newLength = endIndex > beginIndex ? endIndex - beginIndex : 0;
         int srcByteOffset = wrapper->byteoffset();
 
         ESValue arg[3] = {buffer, ESValue(srcByteOffset + beginIndex * wrapper->elementSize()), ESValue(newLength)};
@@ -5221,12 +5479,97 @@ ESFunctionObject* GlobalObject::installTypedArray(escargot::ESString* ta_name)
         ESValue ret = ESFunctionObject::call(instance, thisBinded->get(strings->constructor.string()), newobj, arg, 3, instance);
         return ret;
     }, strings->subarray));
+    // $22.2.3.8 %TypedArray%.prototype.fill(value [, start [, end]])
+    ta_prototype->ESObject::defineDataProperty(strings->fill, true, false, true, ESFunctionObject::create(NULL, [](ESVMInstance* instance)->ESValue {
+        RESOLVE_THIS_BINDING_TO_OBJECT(thisBinded, TypedArray, fill);
+        if (!thisBinded->isESTypedArrayObject())
+            throwBuiltinError(instance, ErrorCode::TypeError, strings->TypedArray, true, strings->fill, errorMessage_GlobalObject_ThisNotTypedArrayObject);
+        auto wrapper = thisBinded->asESTypedArrayObjectWrapper();
+        unsigned len = wrapper->arraylength();
+        ESValue value(instance->currentExecutionContext()->readArgument(0).toNumber());
+        unsigned k = typedArrayRelativeIndex(instance->currentExecutionContext()->readArgument(1), len, 0);
+        unsigned final_ = typedArrayRelativeIndex(instance->currentExecutionContext()->readArgument(2), len, len);
+        if (k >= final_)
+            return thisBinded;
+
+        // store the first element, then repeat its bytes
+        wrapper->set(k, value);
+        int8_t* data = (int8_t*)wrapper->rawData();
+        switch (wrapper->elementSize()) {
+        case 1:
+            memset(data + k + 1, data[k], final_ - k - 1);
+            break;
+        case 2:
+            std::fill((uint16_t*)data + k + 1, (uint16_t*)data + final_, ((uint16_t*)data)[k]);
+            break;
+        case 4:
+            std::fill((uint32_t*)data + k + 1, (uint32_t*)data + final_, ((uint32_t*)data)[k]);
+            break;
+        case 8:
+            std::fill((uint64_t*)data + k + 1, (uint64_t*)data + final_, ((uint64_t*)data)[k]);
+            break;
+        default:
+            RELEASE_ASSERT_NOT_REACHED();
+        }
+        return thisBinded;
+    }, strings->fill, 1));
+    // $22.2.3.5 %TypedArray%.prototype.copyWithin(target, start [, end])
+    ta_prototype->ESObject::defineDataProperty(strings->copyWithin, true, false, true, ESFunctionObject::create(NULL, [](ESVMInstance* instance)->ESValue {
+        RESOLVE_THIS_BINDING_TO_OBJECT(thisBinded, TypedArray, copyWithin);
+        if (!thisBinded->isESTypedArrayObject())
+            throwBuiltinError(instance, ErrorCode::TypeError, strings->TypedArray, true, strings->copyWithin, errorMessage_GlobalObject_ThisNotTypedArrayObject);
+        auto wrapper = thisBinded->asESTypedArrayObjectWrapper();
+        unsigned len = wrapper->arraylength();
+        unsigned to = typedArrayRelativeIndex(instance->currentExecutionContext()->readArgument(0), len, 0);
+        unsigned from = typedArrayRelativeIndex(instance->currentExecutionContext()->readArgument(1), len, 0);
+        unsigned final_ = typedArrayRelativeIndex(instance->currentExecutionContext()->readArgument(2), len, len);
+        if (final_ > from) {
+            unsigned count = std::min(final_ - from, len - to);
+            unsigned elementSize = wrapper->elementSize();
+            int8_t* data = (int8_t*)wrapper->rawData();
+            memmove(data + to * elementSize, data + from * elementSize, count * elementSize);
+        }
+        return thisBinded;
+    }, strings->copyWithin, 2));
+    // $22.2.3.23 %TypedArray%.prototype.slice(start, end)
+    ta_prototype->ESObject::defineDataProperty(strings->slice, true, false, true, ESFunctionObject::create(NULL, [](ESVMInstance* instance)->ESValue {
+        RESOLVE_THIS_BINDING_TO_OBJECT(thisBinded, TypedArray, slice);
+        if (!thisBinded->isESTypedArrayObject())
+            throwBuiltinError(instance, ErrorCode::TypeError, strings->TypedArray, true, strings->slice, errorMessage_GlobalObject_ThisNotTypedArrayObject);
+        auto wrapper = thisBinded->asESTypedArrayObjectWrapper();
+        unsigned len = wrapper->arraylength();
+        unsigned k = typedArrayRelativeIndex(instance->currentExecutionContext()->readArgument(0), len, 0);
+        unsigned final_ = typedArrayRelativeIndex(instance->currentExecutionContext()->readArgument(1), len, len);
+        unsigned count = final_ > k ? final_ - k : 0;
+
+        ESValue arg[1] = {ESValue(count)};
+        escargot::ESTypedArrayObject<T>* newobj = escargot::ESTypedArrayObject<T>::create();
+        ESValue ret = ESFunctionObject::call(instance, thisBinded->get(strings->constructor.string()), newobj, arg, 1, instance);
+        if (!ret.isObject() || !ret.asESPointer()->isESTypedArrayObject())
+            throwBuiltinError(instance, ErrorCode::TypeError, strings->TypedArray, true, strings->slice, "%s: constructor did not return a Typed Array object");
+        auto newWrapper = ret.asESPointer()->asESTypedArrayObjectWrapper();
+        if (newWrapper->arraylength() < count)
+            throwBuiltinError(instance, ErrorCode::TypeError, strings->TypedArray, true, strings->slice, "%s: constructor returned a Typed Array object that is too short");
+        // the constructor may have run user code
+        len = wrapper->arraylength();
+        final_ = std::min(final_, len);
+        if (k < final_) {
+            if (newWrapper->arraytype() == wrapper->arraytype()) {
+                unsigned elementSize = wrapper->elementSize();
+                memmove(newWrapper->rawData(), (int8_t*)wrapper->rawData() + k * elementSize, (final_ - k) * elementSize);
+            } else {
+                for (unsigned n = 0; k < final_; k++, n++)
+                    newWrapper->set(n, wrapper->get(k));
+            }
+        }
+        return ret;
+    }, strings->slice, 2));
 
     ta_constructor->set__proto__(m_functionPrototype); // empty Function
     ta_constructor->setProtoType(ta_prototype);
     ta_prototype->set__proto__(m_objectPrototype);
     ta_prototype->defineDataProperty(strings->constructor, true, false, true, ta_constructor);
-    defineDataProperty(ta_name, true, false, true, ta_constructor);
+    defineBuiltinGlobal(ta_name, ta_constructor);
     return ta_constructor;
 }
 
@@ -5630,29 +5973,83 @@ void GlobalObject::installPromise()
 
     m_promise->set__proto__(m_functionPrototype); // empty Function
     m_promise->setProtoType(m_promisePrototype);
-    defineDataProperty(strings->Promise, true, false, true, m_promise);
+    defineBuiltinGlobal(strings->Promise.string(), m_promise);
 }
 
 #endif
 
+// Blocks are not finalized: their bytecode is collected memory, so a dead block only
+// leaves its entry behind, and the collector tells us by clearing the link.
 void GlobalObject::registerCodeBlock(CodeBlock* cb)
 {
-    m_codeBlocks.push_back(cb);
+    sweepCodeBlocks();
+
+    CodeBlockRegistryEntry* entry = new CodeBlockRegistryEntry;
+    entry->m_codeBlock = cb;
+    entry->m_prev = NULL;
+    entry->m_next = m_codeBlocks;
+    if (m_codeBlocks)
+        m_codeBlocks->m_prev = entry;
+    m_codeBlocks = entry;
+#if !defined(ENABLE_ESJIT) && defined(NDEBUG)
+    GC_general_register_disappearing_link((void**)&entry->m_codeBlock, cb);
+#endif
+    cb->m_registryEntry = entry;
+}
+
+static void removeCodeBlockRegistryEntry(CodeBlockRegistryEntry*& head, CodeBlockRegistryEntry* entry)
+{
+    if (entry->m_prev)
+        entry->m_prev->m_next = entry->m_next;
+    else
+        head = entry->m_next;
+    if (entry->m_next)
+        entry->m_next->m_prev = entry->m_prev;
+    delete entry;
 }
 
 void GlobalObject::unregisterCodeBlock(CodeBlock* cb)
 {
-    auto iter = std::find(m_codeBlocks.begin(), m_codeBlocks.end(), cb);
-    if (iter != m_codeBlocks.end())
-        m_codeBlocks.erase(iter);
+    CodeBlockRegistryEntry* entry = cb->m_registryEntry;
+    if (!entry)
+        return;
+    ASSERT(entry->m_codeBlock == cb);
+#if !defined(ENABLE_ESJIT) && defined(NDEBUG)
+    GC_unregister_disappearing_link((void**)&entry->m_codeBlock);
+#endif
+    cb->m_registryEntry = NULL;
+    removeCodeBlockRegistryEntry(m_codeBlocks, entry);
+}
+
+void GlobalObject::sweepCodeBlocks()
+{
+    // blocks with a finalizer unregister themselves, and the collector keeps them
+    // alive until it has run, so their entries never hold a dead block
+#if !defined(ENABLE_ESJIT) && defined(NDEBUG)
+    size_t gcNumber = GC_get_gc_no();
+    if (gcNumber == m_codeBlocksSweptAtGCNumber)
+        return;
+    m_codeBlocksSweptAtGCNumber = gcNumber;
+
+    CodeBlockRegistryEntry* entry = m_codeBlocks;
+    while (entry) {
+        CodeBlockRegistryEntry* next = entry->m_next;
+        // the collector unregisters a link when it clears it
+        if (!entry->m_codeBlock)
+            removeCodeBlockRegistryEntry(m_codeBlocks, entry);
+        entry = next;
+    }
+#endif
 }
 
 void GlobalObject::propertyDeleted(size_t deletedIdx)
 {
-    for (unsigned i = 0; i < m_codeBlocks.size() ; i ++) {
-        if (m_codeBlocks[i]->m_isBuiltInFunction)
+    sweepCodeBlocks();
+    for (CodeBlockRegistryEntry* entry = m_codeBlocks; entry; entry = entry->m_next) {
+        CodeBlock* block = entry->m_codeBlock;
+        if (!block || block->m_isBuiltInFunction)
             continue;
-        iterateByteCode(m_codeBlocks[i], [&deletedIdx](CodeBlock* block, unsigned idx, ByteCode* code, Opcode opcode) {
+        iterateByteCode(block, [&deletedIdx](CodeBlock* block, unsigned idx, ByteCode* code, Opcode opcode) {
             switch (opcode) {
             case GetByGlobalIndexOpcode:
                 {
@@ -5685,10 +6082,12 @@ void GlobalObject::propertyDefined(size_t newIndex, escargot::ESString* name)
     }
 
     if (isRedefined) {
-        for (unsigned i = 0; i < m_codeBlocks.size() ; i ++) {
-            if (m_codeBlocks[i]->m_isBuiltInFunction)
+        sweepCodeBlocks();
+        for (CodeBlockRegistryEntry* entry = m_codeBlocks; entry; entry = entry->m_next) {
+            CodeBlock* block = entry->m_codeBlock;
+            if (!block || block->m_isBuiltInFunction)
                 continue;
-            iterateByteCode(m_codeBlocks[i], [name, newIndex](CodeBlock* block, unsigned idx, ByteCode* code, Opcode opcode) {
+            iterateByteCode(block, [name, newIndex](CodeBlock* block, unsigned idx, ByteCode* code, Opcode opcode) {
                 switch (opcode) {
                 case GetByGlobalIndexOpcode:
                     {
@@ -5718,11 +6117,12 @@ void GlobalObject::somePrototypeObjectDefineIndexedProperty()
         fprintf(stderr, "some prototype object define indexed property.....\n");
 #endif
         m_didSomePrototypeObjectDefineIndexedProperty = true;
-        for (unsigned i = 0; i < m_codeBlocks.size() ; i ++) {
-            // printf("%p..\n", m_codeBlocks[i]);
-            if (m_codeBlocks[i]->m_isBuiltInFunction)
+        sweepCodeBlocks();
+        for (CodeBlockRegistryEntry* entry = m_codeBlocks; entry; entry = entry->m_next) {
+            CodeBlock* block = entry->m_codeBlock;
+            if (!block || block->m_isBuiltInFunction)
                 continue;
-            iterateByteCode(m_codeBlocks[i], [](CodeBlock* block, unsigned idx, ByteCode* code, Opcode opcode) {
+            iterateByteCode(block, [](CodeBlock* block, unsigned idx, ByteCode* code, Opcode opcode) {
                 switch (opcode) {
                 case GetObjectPreComputedCaseOpcode:
                     {
@@ -40,6 +40,17 @@ typedef ESErrorObject::Code ErrorCode;
 NEVER_INLINE void throwBuiltinError(ESVMInstance* instance, ESErrorObject::Code code,
     const InternalAtomicString& objectName, bool prototoype, const InternalAtomicString& functionName, const char* templateString);
 
+// A weak reference to a CodeBlock, in the malloc heap so the collector does not trace it.
+// m_codeBlock is a disappearing link: the collector clears it when the block dies,
+// and the entry is freed by the next GlobalObject::sweepCodeBlocks.
+// Builds where blocks have a finalizer (ENABLE_ESJIT or debug) use no link: the
+// finalizer runs before a link would be cleared, and unregisters the block itself.
+struct CodeBlockRegistryEntry {
+    CodeBlock* m_codeBlock;
+    CodeBlockRegistryEntry* m_prev;
+    CodeBlockRegistryEntry* m_next;
+};
+
 class JSBuiltinsObject;
 class GlobalObject : public ESObject {
 public:
@@ -47,6 +58,23 @@ public:
     GlobalObject();
     void finalize();
 
+    // Builtins that most scripts never touch are installed on first use.
+    // Until then their global properties are native accessors that install the builtin
+    // and replace themselves with its constructor, the prototype getters below install
+    // it for objects created internally, and the constructor getters return null.
+    enum LazyBuiltin {
+        LazyJSON,
+        LazyDate,
+        LazyRegExp,
+#ifdef USE_ES6_FEATURE
+        LazyArrayBuffer,
+        LazyTypedArray,
+        LazyPromise,
+#endif
+        LazyBuiltinCount
+    };
+    void installLazyBuiltin(LazyBuiltin builtin);
+
     ALWAYS_INLINE escargot::ESVMInstance* instance()
     {
         return m_instance;
@@ -139,6 +167,8 @@ public:
 
     ALWAYS_INLINE escargot::ESRegExpObject* regexpPrototype()
     {
+        if (UNLIKELY(!m_regexpPrototype))
+            installLazyBuiltin(LazyRegExp);
         return m_regexpPrototype;
     }
 
@@ -184,6 +214,8 @@ public:
 
     ALWAYS_INLINE escargot::ESDateObject* datePrototype()
     {
+        if (UNLIKELY(!m_datePrototype))
+            installLazyBuiltin(LazyDate);
         return m_datePrototype;
     }
 
@@ -194,6 +226,8 @@ public:
 
     ALWAYS_INLINE escargot::ESObject* json()
     {
+        if (UNLIKELY(!m_json))
+            installLazyBuiltin(LazyJSON);
         return m_json;
     }
 
@@ -240,6 +274,8 @@ public:
 
     ALWAYS_INLINE escargot::ESObject* int8ArrayPrototype()
     {
+        if (UNLIKELY(!m_Int8ArrayPrototype))
+            installLazyBuiltin(LazyTypedArray);
         return m_Int8ArrayPrototype;
     }
 
@@ -250,6 +286,8 @@ public:
 
     ALWAYS_INLINE escargot::ESObject* uint8ArrayPrototype()
     {
+        if (UNLIKELY(!m_Uint8ArrayPrototype))
+            installLazyBuiltin(LazyTypedArray);
         return m_Uint8ArrayPrototype;
     }
 
@@ -260,6 +298,8 @@ public:
 
     ALWAYS_INLINE escargot::ESObject* int16ArrayPrototype()
     {
+        if (UNLIKELY(!m_Int16ArrayPrototype))
+            installLazyBuiltin(LazyTypedArray);
         return m_Int16ArrayPrototype;
     }
 
@@ -270,6 +310,8 @@ public:
 
     ALWAYS_INLINE escargot::ESObject* uint16ArrayPrototype()
     {
+        if (UNLIKELY(!m_Uint16ArrayPrototype))
+            installLazyBuiltin(LazyTypedArray);
         return m_Uint16ArrayPrototype;
     }
 
@@ -280,6 +322,8 @@ public:
 
     ALWAYS_INLINE escargot::ESObject* int32ArrayPrototype()
     {
+        if (UNLIKELY(!m_Int32ArrayPrototype))
+            installLazyBuiltin(LazyTypedArray);
         return m_Int32ArrayPrototype;
     }
 
@@ -290,6 +334,8 @@ public:
 
     ALWAYS_INLINE escargot::ESObject* uint32ArrayPrototype()
     {
+        if (UNLIKELY(!m_Uint32ArrayPrototype))
+            installLazyBuiltin(LazyTypedArray);
         return m_Uint32ArrayPrototype;
     }
 
@@ -300,6 +346,8 @@ public:
 
     ALWAYS_INLINE escargot::ESObject* uint8ClampedArrayPrototype()
     {
+        if (UNLIKELY(!m_Uint8ClampedArrayPrototype))
+            installLazyBuiltin(LazyTypedArray);
         return m_Uint8ClampedArrayPrototype;
     }
 
@@ -310,6 +358,8 @@ public:
 
     ALWAYS_INLINE escargot::ESObject* float32ArrayPrototype()
     {
+        if (UNLIKELY(!m_Float32ArrayPrototype))
+            installLazyBuiltin(LazyTypedArray);
         return m_Float32ArrayPrototype;
     }
 
@@ -320,6 +370,8 @@ public:
 
     ALWAYS_INLINE escargot::ESObject* float64ArrayPrototype()
     {
+        if (UNLIKELY(!m_Float64ArrayPrototype))
+            installLazyBuiltin(LazyTypedArray);
         return m_Float64ArrayPrototype;
     }
 
@@ -356,11 +408,18 @@ public:
 
     ALWAYS_INLINE escargot::ESObject* arrayBufferPrototype()
     {
+        if (UNLIKELY(!m_arrayBufferPrototype))
+            installLazyBuiltin(LazyArrayBuffer);
         return m_arrayBufferPrototype;
     }
 
     ALWAYS_INLINE escargot::ESFunctionObject* promise() { return m_promise; }
-    ALWAYS_INLINE escargot::ESObject* promisePrototype() { return m_promisePrototype; }
+    ALWAYS_INLINE escargot::ESObject* promisePrototype()
+    {
+        if (UNLIKELY(!m_promisePrototype))
+            installLazyBuiltin(LazyPromise);
+        return m_promisePrototype;
+    }
     ALWAYS_INLINE escargot::NativeFunctionType getCapabilitiesExecutorFunction() { return m_getCapabilitiesExecutorFunction; }
     ALWAYS_INLINE escargot::NativeFunctionType promiseResolveFunction() { return m_promiseResolveFunction; }
     ALWAYS_INLINE escargot::NativeFunctionType promiseRejectFunction() { return m_promiseRejectFunction; }
@@ -412,6 +471,8 @@ public:
 
     void registerCodeBlock(CodeBlock* cb);
     void unregisterCodeBlock(CodeBlock* cb);
+    // drops the entries of the blocks that died, once per collection
+    void sweepCodeBlocks();
 
     void setIdentifierInterceptor(PropertyReadCallback cb)
     {
@@ -454,6 +515,10 @@ protected:
     escargot::ESFunctionObject* installTypedArray(escargot::ESString*);
     void installPromise();
 #endif
+    void defineLazyBuiltin(escargot::ESString* name, LazyBuiltin builtin);
+    void installLazyBuiltin(escargot::ESString* name);
+    // unless user code has already replaced or deleted the lazy global property
+    void defineBuiltinGlobal(escargot::ESString* name, escargot::ESObject* builtin);
 
     escargot::ESVMInstance* m_instance;
 
@@ -527,8 +592,13 @@ protected:
     escargot::ESFunctionObject* m_eval;
     escargot::ESFunctionObject* m_objectProtoTypeToString;
 
+    ESPropertyAccessorData* m_lazyBuiltinAccessorData;
+    std::vector<std::pair<escargot::ESString*, LazyBuiltin>, gc_allocator<std::pair<escargot::ESString*, LazyBuiltin> > > m_lazyBuiltinNames;
+    bool m_isLazyBuiltinInstalled[LazyBuiltinCount];
+
     bool m_didSomePrototypeObjectDefineIndexedProperty;
-    std::vector<CodeBlock*, pointer_free_allocator<CodeBlock*> > m_codeBlocks;
+    CodeBlockRegistryEntry* m_codeBlocks;
+    size_t m_codeBlocksSweptAtGCNumber;
 
     PropertyReadCallback m_identifierInterceptor;
 };
@@ -102,7 +102,7 @@ void GlobalObject::installDate()
 
     m_datePrototype->defineDataProperty(strings->constructor, true, false, true, m_date);
 
-    defineDataProperty(strings->Date, true, false, true, m_date);
+    defineBuiltinGlobal(strings->Date.string(), m_date);
 
     // $20.3.3.1 Date.now()
     m_date->defineDataProperty(strings->now, true, false, true, ESFunctionObject::create(NULL, [](ESVMInstance* instance)->ESValue {
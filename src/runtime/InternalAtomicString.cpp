@@ -74,17 +74,66 @@ InternalAtomicString::InternalAtomicString(ESVMInstance* instance, const char* s
 }
 
 
+void ESVMInstance::sweepAtomicStringMap()
+{
+    auto iter = m_atomicStringMap.begin();
+    while (iter != m_atomicStringMap.end()) {
+        // the slot was cleared by GC. the key may point into the dead string, so drop it before
+        // anything compares it. erasing only uses the hash stored in the key, not its characters
+        if (!iter->second.m_string) {
+            if (iter->second.m_ownsKey)
+                free((void *)iter->first.m_data);
+            iter = m_atomicStringMap.erase(iter);
+            m_atomicStringMapSweptEntryCount++;
+        } else {
+            iter++;
+        }
+    }
+    m_atomicStringMapSweptGCCount = GC_get_gc_no();
+}
+
+void ESVMInstance::insertAtomicString(const char* key, size_t keyLength, ESString* string, bool ownsKey)
+{
+    InternalAtomicStringMapEntry entry;
+    entry.m_string = string;
+    entry.m_ownsKey = ownsKey;
+    auto result = m_atomicStringMap.insert(std::make_pair(InternalAtomicStringKey(key, keyLength), entry));
+    ASSERT(result.second);
+    GC_general_register_disappearing_link((void **)&result.first->second.m_string, string);
+}
+
+InternalAtomicStringMapStatistics ESVMInstance::atomicStringMapStatistics()
+{
+    sweepAtomicStringMapIfNeeded();
+    InternalAtomicStringMapStatistics stat;
+    stat.m_entryCount = m_atomicStringMap.size();
+    stat.m_bucketCount = m_atomicStringMap.bucket_count();
+    stat.m_collidedBucketCount = 0;
+    stat.m_longestChainLength = 0;
+    stat.m_sweptEntryCount = m_atomicStringMapSweptEntryCount;
+    for (size_t i = 0; i < stat.m_bucketCount; i ++) {
+        size_t len = m_atomicStringMap.bucket_size(i);
+        if (len > 1)
+            stat.m_collidedBucketCount++;
+        stat.m_longestChainLength = std::max(stat.m_longestChainLength, len);
+    }
+    return stat;
+}
+
 void InternalAtomicString::init(ESVMInstance* instance, const char* src, size_t len)
 {
     ASSERT(instance);
-    auto iter = instance->m_atomicStringMap.find(std::make_pair(src, len));
+    instance->sweepAtomicStringMapIfNeeded();
+    auto iter = instance->m_atomicStringMap.find(InternalAtomicStringKey(src, len));
     if (iter == instance->m_atomicStringMap.end()) {
         ASCIIString s(src, &src[len]);
         ESString* newData = ESString::create(std::move(s));
-        instance->m_atomicStringMap.insert(std::make_pair(std::make_pair(newData->asciiData(), len), newData));
+        // creating the string may have triggered GC
+        instance->sweepAtomicStringMapIfNeeded();
+        instance->insertAtomicString(newData->asciiData(), len, newData, false);
         m_string = newData;
     } else {
-        m_string = iter->second;
+        m_string = iter->second.m_string;
     }
 }
 
@@ -95,23 +144,26 @@ void InternalAtomicString::init(ESVMInstance* instance, const char16_t* src, siz
     if (isAllASCII(src, u16len)) {
         char* abuf;
         ALLOCA_WRAPPER(instance, abuf, char*, u16len, true);
-        for (unsigned i = 0 ; i < u16len ; i ++) {
-            abuf[i] = src[i];
-        }
+        narrowASCII(src, u16len, abuf);
         init(instance, abuf, u16len);
         return;
     }
     size_t siz;
     const char* buf = utf16ToUtf8(src, u16len, &siz);
     siz--;
-    auto iter = instance->m_atomicStringMap.find(std::make_pair(buf, siz));
+    instance->sweepAtomicStringMapIfNeeded();
+    auto iter = instance->m_atomicStringMap.find(InternalAtomicStringKey(buf, siz));
     if (iter == instance->m_atomicStringMap.end()) {
         UTF16String s(src, &src[u16len]);
         ESString* newData = ESString::create(std::move(s));
-        instance->m_atomicStringMap.insert(std::make_pair(std::make_pair(buf, siz), newData));
+        // the table is not scanned by GC, so it needs its own copy of the key
+        char* key = (char *)malloc(siz);
+        memcpy(key, buf, siz);
+        instance->sweepAtomicStringMapIfNeeded();
+        instance->insertAtomicString(key, siz, newData, true);
         m_string = newData;
     } else {
-        m_string = iter->second;
+        m_string = iter->second.m_string;
     }
 }
 
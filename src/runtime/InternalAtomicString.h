@@ -105,24 +105,43 @@ template<> struct equal_to<escargot::InternalAtomicString> {
 
 }
 
-namespace std {
-template<> struct hash<std::pair<const char *, size_t> > {
-    size_t operator()(std::pair<const char *, size_t> const &x) const
+namespace escargot {
+
+// Key of the atomic string table (see ESVMInstance.h).
+// The hash is computed from the characters once and kept, because the table outlives
+// the characters of a collected string: rehashing or erasing its entry must not read them.
+struct InternalAtomicStringKey {
+    InternalAtomicStringKey(const char* data, size_t length)
+        : m_data(data)
+        , m_length(length)
     {
-        size_t length = x.second;
         size_t hash = static_cast<size_t>(0xc70f6907UL);
-        const char* cptr = reinterpret_cast<const char*>(x.first);
-        for (; length; --length)
-            hash = (hash * 131) + *cptr++;
-        return hash;
+        for (size_t i = 0; i < length; i ++)
+            hash = (hash * 131) + data[i];
+        m_hash = hash;
+    }
+
+    const char* m_data;
+    size_t m_length;
+    size_t m_hash;
+};
+
+}
+
+namespace std {
+template<> struct hash<escargot::InternalAtomicStringKey> {
+    size_t operator()(escargot::InternalAtomicStringKey const &x) const
+    {
+        return x.m_hash;
     }
 };
 
-template<> struct equal_to<std::pair<const char *, size_t> > {
-    bool operator()(std::pair<const char *, size_t> const &a, std::pair<const char *, size_t> const &b) const
+// only called while probing for a live key, so the characters of both sides are valid
+template<> struct equal_to<escargot::InternalAtomicStringKey> {
+    bool operator()(escargot::InternalAtomicStringKey const &a, escargot::InternalAtomicStringKey const &b) const
     {
-        if (a.second == b.second) {
-            return memcmp(a.first, b.first, sizeof(char) * a.second) == 0;
+        if (a.m_hash == b.m_hash && a.m_length == b.m_length) {
+            return memcmp(a.m_data, b.m_data, sizeof(char) * a.m_length) == 0;
         }
         return false;
     }
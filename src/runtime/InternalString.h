@@ -17,6 +17,8 @@
 #ifndef InternalString_h
 #define InternalString_h
 
+#include "StringOperations.h"
+
 namespace escargot {
 class ESString;
 
@@ -54,9 +56,11 @@ ALWAYS_INLINE size_t utf16ToUtf8(char16_t uc, char* UTF8)
 
 inline const char * utf16ToUtf8(const char16_t *t, const size_t& len, size_t* bufferSize = NULL)
 {
-    unsigned strLength = 0;
+    // ASCII prefix maps 1:1 onto UTF-8, so narrow it in bulk
+    size_t asciiLength = asciiPrefixLength(t, len);
+    unsigned strLength = asciiLength;
     char buffer[MB_CUR_MAX];
-    for (size_t i = 0; i < len ; i ++) {
+    for (size_t i = asciiLength; i < len ; i ++) {
         int length = utf16ToUtf8(t[i], buffer);
         strLength += length;
     }
@@ -64,9 +68,10 @@ inline const char * utf16ToUtf8(const char16_t *t, const size_t& len, size_t* bu
     char* result = (char *)GC_MALLOC_ATOMIC(strLength + 1);
     if (bufferSize)
         *bufferSize = strLength + 1;
-    unsigned currentPosition = 0;
+    narrowASCII(t, asciiLength, result);
+    unsigned currentPosition = asciiLength;
 
-    for (size_t i = 0; i < len ; i ++) {
+    for (size_t i = asciiLength; i < len ; i ++) {
         int length = utf16ToUtf8(t[i], buffer);
         memcpy(&result[currentPosition], buffer, length);
         currentPosition += length;
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "Escargot.h"
+#include "JSONParser.h"
+#include "GlobalObject.h"
+#include "vm/ESVMInstance.h"
+
+namespace escargot {
+
+// rapidjson SAX handler that builds ES values bottom-up.
+// Finished values are kept on m_valueStack (object members as key, value pairs)
+// until the enclosing container ends and consumes them.
+template <typename CharType>
+class JSONObjectBuilder {
+public:
+    typedef CharType Ch;
+
+    JSONObjectBuilder(ESVMInstance* instance)
+        : m_instance(instance)
+    {
+        memset(m_keyCache, 0, sizeof(m_keyCache));
+        memset(m_transitionCache, 0, sizeof(m_transitionCache));
+        m_valueStack.reserve(32);
+    }
+
+    bool Null()
+    {
+        m_valueStack.push_back(ESValue(ESValue::ESNull));
+        return true;
+    }
+
+    bool Bool(bool b)
+    {
+        m_valueStack.push_back(ESValue(b));
+        return true;
+    }
+
+    bool Int(int i)
+    {
+        m_valueStack.push_back(ESValue(i));
+        return true;
+    }
+
+    bool Uint(unsigned i)
+    {
+        m_valueStack.push_back(ESValue(i));
+        return true;
+    }
+
+    bool Int64(int64_t i)
+    {
+        m_valueStack.push_back(ESValue(i));
+        return true;
+    }
+
+    bool Uint64(uint64_t i)
+    {
+        m_valueStack.push_back(ESValue(i));
+        return true;
+    }
+
+    bool Double(double d)
+    {
+        m_valueStack.push_back(ESValue(d));
+        return true;
+    }
+
+    bool String(const Ch* str, rapidjson::SizeType length, bool)
+    {
+        m_valueStack.push_back(createString(str, length));
+        return true;
+    }
+
+    bool StartObject()
+    {
+        return true;
+    }
+
+    bool Key(const Ch* str, rapidjson::SizeType length, bool)
+    {
+        m_valueStack.push_back(atomizeKey(str, length));
+        return true;
+    }
+
+    bool EndObject(rapidjson::SizeType memberCount)
+    {
+        size_t base = m_valueStack.size() - memberCount * 2;
+        ESObject* obj = ESObject::create(memberCount + 1);
+        for (size_t i = base; i < m_valueStack.size(); i += 2) {
+            defineMember(obj, m_valueStack[i].asESString(), m_valueStack[i + 1]);
+        }
+        m_valueStack.resize(base);
+        m_valueStack.push_back(obj);
+        return true;
+    }
+
+    bool StartArray()
+    {
+        return true;
+    }
+
+    bool EndArray(rapidjson::SizeType elementCount)
+    {
+        size_t base = m_valueStack.size() - elementCount;
+        ESArrayObject* arr = ESArrayObject::create(elementCount);
+        if (arr->isFastmode()) {
+            ESValue* data = arr->data();
+            for (size_t i = 0; i < elementCount; i ++) {
+                data[i] = m_valueStack[base + i];
+            }
+        } else {
+            for (size_t i = 0; i < elementCount; i ++) {
+                arr->defineDataProperty(ESValue(i), true, true, true, m_valueStack[base + i]);
+            }
+        }
+        m_valueStack.resize(base);
+        m_valueStack.push_back(arr);
+        return true;
+    }
+
+    ESValue result()
+    {
+        ASSERT(m_valueStack.size() == 1);
+        return m_valueStack[0];
+    }
+
+private:
+    static ESString* createString(const char* str, size_t length)
+    {
+        if (!length)
+            return strings->emptyString.string();
+        return ESString::createUTF16StringIfNeeded(str, length);
+    }
+
+    static ESString* createString(const char16_t* str, size_t length)
+    {
+        if (!length)
+            return strings->emptyString.string();
+        return ESString::createASCIIStringIfNeeded(str, length);
+    }
+
+    // Documents usually repeat a handful of keys many times, so ASCII keys are
+    // looked up in a small per-parse cache before going to the atomic string table.
+    ESString* atomizeKey(const Ch* str, size_t length)
+    {
+        if (asciiPrefixLength(str, length) != length)
+            return atomizeNonASCIIKey(str, length);
+
+        size_t hash = length;
+        for (size_t i = 0; i < length; i ++) {
+            hash = hash * 31 + str[i];
+        }
+        ESString*& entry = m_keyCache[hash % KeyCacheSize];
+        if (entry && entry->length() == length && stringMismatch(str, entry->asciiData(), length) == length)
+            return entry;
+
+        ESString* key;
+        if (std::is_same<Ch, char>::value) {
+            key = InternalAtomicString(m_instance, (const char*)str, length).string();
+        } else {
+            key = InternalAtomicString(m_instance, (const char16_t*)str, length).string();
+        }
+        ASSERT(key->isASCIIString());
+        entry = key;
+        return key;
+    }
+
+    ESString* atomizeNonASCIIKey(const char* str, size_t length)
+    {
+        UTF16String key = utf8StringToUTF16String(str, length);
+        return InternalAtomicString(m_instance, key.data(), key.length()).string();
+    }
+
+    ESString* atomizeNonASCIIKey(const char16_t* str, size_t length)
+    {
+        return InternalAtomicString(m_instance, str, length).string();
+    }
+
+    // Objects built from one document tend to share their shape, so the hidden class
+    // transition taken for (class, key) is remembered and replayed without a property lookup.
+    // Only vector-mode classes are cached; they are never mutated once created.
+    void defineMember(ESObject* obj, ESString* key, const ESValue& value)
+    {
+        ESHiddenClass* from = obj->m_hiddenClass;
+        TransitionCacheEntry& entry = m_transitionCache[((((size_t)from) >> 4) ^ (((size_t)key) >> 4)) % TransitionCacheSize];
+        if (entry.m_from == from && entry.m_key == key) {
+            obj->m_hiddenClass = entry.m_to;
+            obj->m_hiddenClassData.push_back(value);
+            return;
+        }
+
+        // duplicated keys and "__proto__" go through the generic path
+        bool isNewProperty = from->isVectorMode() && from->findProperty(key) == SIZE_MAX;
+        obj->defineDataProperty(key, true, true, true, value, true);
+        if (isNewProperty && obj->m_hiddenClass->isVectorMode()) {
+            entry.m_from = from;
+            entry.m_key = key;
+            entry.m_to = obj->m_hiddenClass;
+        }
+    }
+
+    static const size_t KeyCacheSize = 64;
+    static const size_t TransitionCacheSize = 64;
+
+    struct TransitionCacheEntry {
+        ESHiddenClass* m_from;
+        ESString* m_key;
+        ESHiddenClass* m_to;
+    };
+
+    ESVMInstance* m_instance;
+    ESValueVectorStd m_valueStack;
+    ESString* m_keyCache[KeyCacheSize];
+    TransitionCacheEntry m_transitionCache[TransitionCacheSize];
+};
+
+// rapidjson input stream over the chunks of a JSONStreamParser. Peek() reads '\0' at the end
+class JSONChunkStream {
+public:
+    typedef char Ch;
+
+    JSONChunkStream(const std::vector<JSONStreamParser::Chunk>& chunks)
+        : m_chunks(chunks)
+        , m_nextChunk(0)
+        , m_chunkStart(NULL)
+        , m_current(NULL)
+        , m_end(NULL)
+        , m_chunkOffset(0)
+    {
+        nextChunk();
+    }
+
+    Ch Peek() const
+    {
+        return m_current != m_end ? *m_current : '\0';
+    }
+
+    Ch Take()
+    {
+        if (m_current == m_end)
+            return '\0';
+        Ch c = *m_current++;
+        if (m_current == m_end)
+            nextChunk();
+        return c;
+    }
+
+    size_t Tell() const
+    {
+        return m_chunkOffset + (m_current - m_chunkStart);
+    }
+
+    Ch* PutBegin() { RELEASE_ASSERT_NOT_REACHED(); }
+    void Put(Ch) { RELEASE_ASSERT_NOT_REACHED(); }
+    void Flush() { RELEASE_ASSERT_NOT_REACHED(); }
+    size_t PutEnd(Ch*) { RELEASE_ASSERT_NOT_REACHED(); }
+
+private:
+    void nextChunk()
+    {
+        if (m_current)
+            m_chunkOffset += m_current - m_chunkStart;
+        if (m_nextChunk < m_chunks.size()) {
+            m_chunkStart = m_current = m_chunks[m_nextChunk].m_data;
+            m_end = m_current + m_chunks[m_nextChunk].m_length;
+            m_nextChunk++;
+        } else {
+            m_chunkStart = m_current = m_end;
+        }
+    }
+
+    const std::vector<JSONStreamParser::Chunk>& m_chunks;
+    size_t m_nextChunk;
+    const char* m_chunkStart;
+    const char* m_current;
+    const char* m_end;
+    size_t m_chunkOffset;
+};
+
+// errors are thrown (which longjmps) only once the reader has been destroyed, so its buffers do not leak
+template <unsigned parseFlags, typename JSONCharType, typename InputStream>
+static rapidjson::ParseResult parseJSONStream(InputStream& stream, JSONObjectBuilder<typename JSONCharType::Ch>& builder)
+{
+    rapidjson::GenericReader<JSONCharType, JSONCharType> reader;
+    return reader.template Parse<parseFlags>(stream, builder);
+}
+
+bool JSONStreamParser::finish(ESValue& result)
+{
+    m_errorOffset = SIZE_MAX;
+    m_errorMessage = NULL;
+    JSONObjectBuilder<char> builder(m_instance);
+    JSONChunkStream stream(m_chunks);
+    // embedder input may nest arbitrarily deep, so do not recurse on the C stack
+    rapidjson::ParseResult parseResult = parseJSONStream<rapidjson::kParseIterativeFlag | rapidjson::kParseValidateEncodingFlag, rapidjson::UTF8<char> >(stream, builder);
+    if (parseResult.IsError()) {
+        m_errorOffset = parseResult.Offset();
+        m_errorMessage = rapidjson::GetParseError_En(parseResult.Code());
+        return false;
+    }
+    result = builder.result();
+    return true;
+}
+
+template <typename JSONCharType>
+static ESValue parseJSON(ESVMInstance* instance, const typename JSONCharType::Ch* data)
+{
+    JSONObjectBuilder<typename JSONCharType::Ch> builder(instance);
+    rapidjson::GenericStringStream<JSONCharType> stringStream(data);
+    rapidjson::ParseResult result = parseJSONStream<rapidjson::kParseDefaultFlags, JSONCharType>(stringStream, builder);
+    if (result.IsError()) {
+        throwBuiltinError(instance, ErrorCode::SyntaxError, strings->JSON, true, strings->parse, rapidjson::GetParseError_En(result.Code()));
+    }
+    return builder.result();
+}
+
+ESValue parseJSON(ESVMInstance* instance, ESString* text)
+{
+    // FIXME: JSON.parse treats "__proto__" as a regular property name. (test262: ch15/15.12/15.12.2/S15.12.2_A1.js)
+    //        >>> var x1 = JSON.parse('{"__proto__":[]}') // x1.__proto__ = []
+    //        >>> var x2 = JSON.parse('{"__proto__":1}') // x2.__proto__ = 1
+    //        >>> var y1 = {"__proto__":[]} // y1.__proto__ = []
+    //        >>> var y2 = {"__proto__":1} // y2.__proto__ != 1
+    //        >>> Object.getPrototypeOf(x1) == Object.prototype // true
+    //        >>> Object.getPrototypeOf(x2) == Object.prototype // true
+    //        >>> Object.getPrototypeOf(y1) == Object.prototype // false
+    //        >>> Object.getPrototypeOf(y2) == Object.prototype // true
+    if (text->isASCIIString()) {
+        return parseJSON<rapidjson::UTF8<char>>(instance, text->toNullableUTF8String().m_buffer);
+    }
+    return parseJSON<rapidjson::UTF16<char16_t>>(instance, text->asUTF16String()->data());
+}
+
+}
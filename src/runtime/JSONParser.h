@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef JSONParser_h
+#define JSONParser_h
+
+namespace escargot {
+
+class ESVMInstance;
+
+// Parses JSON text straight into ESObjects and ESArrayObjects.
+// rapidjson is used as a SAX tokenizer only; no intermediate DOM is built.
+// Throws a SyntaxError if the text is malformed.
+ESValue parseJSON(ESVMInstance* instance, ESString* text);
+
+// Parses UTF-8 JSON text that an embedder receives in pieces (see ESVMInstance::createJSONStreamParser).
+// Chunks are read in place rather than concatenated, so every chunk must stay valid
+// until finish() returns. Encoding is validated. Malformed input is reported through
+// the return value of finish() rather than thrown, so it can be called without a try position.
+class JSONStreamParser {
+public:
+    struct Chunk {
+        const char* m_data;
+        size_t m_length;
+    };
+
+    explicit JSONStreamParser(ESVMInstance* instance)
+        : m_instance(instance)
+        , m_totalLength(0)
+        , m_errorOffset(SIZE_MAX)
+        , m_errorMessage(NULL)
+    {
+    }
+
+    void appendChunk(const char* data, size_t length)
+    {
+        if (!length)
+            return;
+        Chunk chunk = { data, length };
+        m_chunks.push_back(chunk);
+        m_totalLength += length;
+    }
+
+    size_t totalLength() { return m_totalLength; }
+
+    // SIZE_MAX unless the last finish() failed; counted in bytes across all chunks
+    size_t errorOffset() { return m_errorOffset; }
+    // NULL unless the last finish() failed
+    const char* errorMessage() { return m_errorMessage; }
+
+    // false if the text is malformed, with errorOffset() and errorMessage() set
+    bool finish(ESValue& result);
+
+private:
+    ESVMInstance* m_instance;
+    std::vector<Chunk> m_chunks;
+    size_t m_totalLength;
+    size_t m_errorOffset;
+    const char* m_errorMessage;
+};
+
+}
+
+#endif
@@ -0,0 +1,440 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "Escargot.h"
+#include "JSONStringifier.h"
+#include "GlobalObject.h"
+#include "vm/ESVMInstance.h"
+
+namespace escargot {
+
+// What JSON.stringify needs to know about a vector mode hidden class:
+// the slots of its enumerable properties and their names already quoted as `"name":`.
+class JSONStringifyCache : public gc {
+public:
+    JSONStringifyCache()
+        : m_canUseFastPath(true)
+        , m_hasNonASCIIName(false)
+    {
+    }
+
+    // false if the class has an own "toJSON" or an enumerable accessor
+    bool m_canUseFastPath;
+    // m_quotedNames is only filled when every name is ASCII
+    bool m_hasNonASCIIName;
+    std::vector<size_t, pointer_free_allocator<size_t> > m_slots;
+    std::vector<char, pointer_free_allocator<char> > m_quotedNames;
+    std::vector<size_t, pointer_free_allocator<size_t> > m_quotedNameOffsets;
+};
+
+template <typename CharType>
+class JSONStringifier {
+public:
+    enum Result {
+        Written,
+        Undefined,
+        NeedsUTF16,
+        Fallback
+    };
+
+    typedef typename std::conditional<std::is_same<CharType, char>::value, ASCIIString, UTF16String>::type OutputString;
+
+    JSONStringifier(ESVMInstance* instance)
+        : m_instance(instance)
+    {
+        GlobalObject* globalObject = instance->globalObject();
+        m_objectPrototype = globalObject->objectPrototype();
+        m_arrayPrototype = globalObject->arrayPrototype();
+        m_toJSON = strings->toJSON.string();
+        // toJSON found through the prototype chain would have to be called
+        m_prototypesAreClean = !m_objectPrototype->hasPropertyInterceptor()
+            && m_objectPrototype->__proto__().isNull()
+            && m_objectPrototype->hiddenClass()->findProperty(m_toJSON) == SIZE_MAX
+            && m_arrayPrototype->__proto__().isESPointer() && m_arrayPrototype->__proto__().asESPointer() == m_objectPrototype
+            && m_arrayPrototype->hiddenClass()->findProperty(m_toJSON) == SIZE_MAX;
+        m_holesReadAsUndefined = !globalObject->didSomePrototypeObjectDefineIndexedProperty();
+    }
+
+    Result serialize(const ESValue& value)
+    {
+        if (value.isInt32()) {
+            appendInt32(value.asInt32());
+            return Written;
+        }
+        if (value.isNumber()) {
+            double d = value.asNumber();
+            if (std::isfinite(d)) {
+                ESString* str = ESValue(d).toString();
+                appendChars(str->asciiData(), str->length());
+            } else {
+                appendLiteral("null");
+            }
+            return Written;
+        }
+        if (value.isNull()) {
+            appendLiteral("null");
+            return Written;
+        }
+        if (value.isBoolean()) {
+            if (value.asBoolean())
+                appendLiteral("true");
+            else
+                appendLiteral("false");
+            return Written;
+        }
+        if (value.isUndefined())
+            return Undefined;
+        if (!value.isESPointer())
+            return Fallback;
+
+        ESPointer* ptr = value.asESPointer();
+        if (ptr->isESString())
+            return serializeString(ptr->asESString());
+        if (!m_prototypesAreClean)
+            return Fallback;
+        int type = ptr->type() & ESPointer::TypeMask;
+        if (type == ESPointer::ESObject)
+            return serializeObject(ptr->asESObject());
+        if (type == (ESPointer::ESObject | ESPointer::ESArrayObject))
+            return serializeArray(ptr->asESArrayObject());
+        return Fallback;
+    }
+
+    OutputString& output()
+    {
+        return m_output;
+    }
+
+private:
+    Result serializeString(ESString* str)
+    {
+        size_t len = str->length();
+        if (str->isASCIIString()) {
+            appendQuoted(str->asciiData(), len);
+            return Written;
+        }
+        const char16_t* src = str->utf16Data();
+        if (!std::is_same<CharType, char16_t>::value && asciiPrefixLength(src, len) != len)
+            return NeedsUTF16;
+        appendQuoted(src, len);
+        return Written;
+    }
+
+    Result serializeArray(ESArrayObject* arr)
+    {
+        if (!arr->isFastmode() || arr->__proto__().asESPointer() != m_arrayPrototype)
+            return Fallback;
+        if (arr->hiddenClass()->findProperty(m_toJSON) != SIZE_MAX)
+            return Fallback;
+        if (!enter(arr))
+            throwBuiltinError(m_instance, ErrorCode::TypeError, strings->JSON, false, strings->stringify, errorMessage_GlobalObject_JAError);
+
+        m_output.push_back('[');
+        // no user code runs on this path, so the array cannot change while it is walked
+        uint32_t len = arr->length();
+        for (uint32_t i = 0; i < len; i ++) {
+            if (i)
+                m_output.push_back(',');
+            ESValue element = arr->data()[i];
+            if (element.isEmpty()) {
+                if (!m_holesReadAsUndefined)
+                    return Fallback;
+                appendLiteral("null");
+                continue;
+            }
+            Result result = serialize(element);
+            if (result == Undefined)
+                appendLiteral("null");
+            else if (result != Written)
+                return result;
+        }
+        m_output.push_back(']');
+
+        leave();
+        return Written;
+    }
+
+    Result serializeObject(ESObject* obj)
+    {
+        if (obj->hasPropertyInterceptor() || obj->__proto__().asESPointer() != m_objectPrototype)
+            return Fallback;
+
+        ESHiddenClass* hiddenClass = obj->hiddenClass();
+        JSONStringifyCache* cache = NULL;
+        if (hiddenClass->isVectorMode()) {
+            cache = hiddenClass->jsonStringifyCache();
+            if (!cache) {
+                cache = buildCache(hiddenClass);
+                hiddenClass->setJSONStringifyCache(cache);
+            }
+            if (!cache->m_canUseFastPath)
+                return Fallback;
+            if (cache->m_hasNonASCIIName && !std::is_same<CharType, char16_t>::value)
+                return NeedsUTF16;
+        }
+
+        if (!enter(obj))
+            throwBuiltinError(m_instance, ErrorCode::TypeError, strings->JSON, false, strings->stringify, errorMessage_GlobalObject_JOError);
+
+        m_output.push_back('{');
+        bool isFirst = true;
+        if (cache && !cache->m_hasNonASCIIName) {
+            for (size_t i = 0; i < cache->m_slots.size(); i ++) {
+                size_t memberStart = m_output.size();
+                if (!isFirst)
+                    m_output.push_back(',');
+                size_t nameStart = cache->m_quotedNameOffsets[i];
+                appendChars(cache->m_quotedNames.data() + nameStart, cache->m_quotedNameOffsets[i + 1] - nameStart);
+                Result result = serialize(obj->m_hiddenClassData[cache->m_slots[i]]);
+                if (result == Undefined) {
+                    m_output.resize(memberStart);
+                    continue;
+                }
+                if (result != Written)
+                    return result;
+                isFirst = false;
+            }
+        } else {
+            const ESHiddenClassPropertyInfoVector& info = hiddenClass->propertyInfo();
+            for (size_t i = 0; i < info.size(); i ++) {
+                if (info[i].isDeleted())
+                    continue;
+                // toJSON is called whether or not it is enumerable
+                if (*info[i].name() == *m_toJSON)
+                    return Fallback;
+                if (!info[i].enumerable())
+                    continue;
+                if (!info[i].isDataProperty())
+                    return Fallback;
+                size_t memberStart = m_output.size();
+                if (!isFirst)
+                    m_output.push_back(',');
+                Result result = serializeString(info[i].name());
+                if (result != Written)
+                    return result;
+                m_output.push_back(':');
+                result = serialize(obj->m_hiddenClassData[i]);
+                if (result == Undefined) {
+                    m_output.resize(memberStart);
+                    continue;
+                }
+                if (result != Written)
+                    return result;
+                isFirst = false;
+            }
+        }
+        m_output.push_back('}');
+
+        leave();
+        return Written;
+    }
+
+    JSONStringifyCache* buildCache(ESHiddenClass* hiddenClass)
+    {
+        JSONStringifyCache* cache = new JSONStringifyCache();
+        const ESHiddenClassPropertyInfoVector& info = hiddenClass->propertyInfo();
+        JSONStringifier<char> nameQuoter(m_instance);
+        for (size_t i = 0; i < info.size(); i ++) {
+            if (*info[i].name() == *m_toJSON || (info[i].enumerable() && !info[i].isDataProperty())) {
+                cache->m_canUseFastPath = false;
+                return cache;
+            }
+            if (!info[i].enumerable())
+                continue;
+            cache->m_slots.push_back(i);
+            cache->m_quotedNameOffsets.push_back(nameQuoter.output().size());
+            if (nameQuoter.serializeString(info[i].name()) != JSONStringifier<char>::Written)
+                cache->m_hasNonASCIIName = true;
+            nameQuoter.output().push_back(':');
+        }
+        if (!cache->m_hasNonASCIIName) {
+            cache->m_quotedNameOffsets.push_back(nameQuoter.output().size());
+            cache->m_quotedNames.assign(nameQuoter.output().begin(), nameQuoter.output().end());
+        } else {
+            cache->m_quotedNameOffsets.clear();
+        }
+        return cache;
+    }
+
+    // cycle detection. short stacks are scanned; deeper ones switch to a hash set
+    static const size_t LinearCycleCheckLimit = 16;
+
+    bool enter(ESObject* obj)
+    {
+        if (m_stack.size() < LinearCycleCheckLimit) {
+            for (size_t i = 0; i < m_stack.size(); i ++) {
+                if (m_stack[i] == obj)
+                    return false;
+            }
+        } else {
+            if (m_stackSet.empty())
+                m_stackSet.insert(m_stack.begin(), m_stack.end());
+            if (!m_stackSet.insert(obj).second)
+                return false;
+        }
+        m_stack.push_back(obj);
+        return true;
+    }
+
+    void leave()
+    {
+        ESObject* obj = m_stack.back();
+        m_stack.pop_back();
+        if (!m_stackSet.empty()) {
+            if (m_stack.size() < LinearCycleCheckLimit)
+                m_stackSet.clear();
+            else
+                m_stackSet.erase(obj);
+        }
+    }
+
+    void appendLiteral(const char* literal)
+    {
+        appendChars(literal, strlen(literal));
+    }
+
+    void appendInt32(int32_t number)
+    {
+        char buffer[12];
+        char* end = buffer + sizeof(buffer);
+        char* p = end;
+        uint32_t n = number < 0 ? -(uint32_t)number : number;
+        do {
+            *--p = '0' + (n % 10);
+            n /= 10;
+        } while (n);
+        if (number < 0)
+            *--p = '-';
+        appendChars(p, end - p);
+    }
+
+    void appendChars(const char* src, size_t len)
+    {
+        if (std::is_same<CharType, char>::value) {
+            m_output.append((const CharType*)src, len);
+        } else {
+            size_t oldSize = m_output.size();
+            m_output.resize(oldSize + len);
+            widenASCII(src, len, (char16_t*)&m_output[oldSize]);
+        }
+    }
+
+    void appendChars(const char16_t* src, size_t len)
+    {
+        if (std::is_same<CharType, char16_t>::value) {
+            m_output.append((const CharType*)src, len);
+        } else {
+            size_t oldSize = m_output.size();
+            m_output.resize(oldSize + len);
+            narrowASCII(src, len, (char*)&m_output[oldSize]);
+        }
+    }
+
+    template <typename SourceCharType>
+    void appendQuoted(const SourceCharType* src, size_t len)
+    {
+        m_output.push_back('"');
+        size_t i = 0;
+        while (true) {
+            size_t safeLength = jsonSafePrefixLength(src + i, len - i);
+            appendChars(src + i, safeLength);
+            i += safeLength;
+            if (i == len)
+                break;
+            appendEscaped(src[i++]);
+        }
+        m_output.push_back('"');
+    }
+
+    void appendEscaped(char16_t c)
+    {
+        m_output.push_back('\\');
+        switch (c) {
+        case '"':
+        case '\\':
+            m_output.push_back(c);
+            break;
+        case '\b':
+            m_output.push_back('b');
+            break;
+        case '\f':
+            m_output.push_back('f');
+            break;
+        case '\n':
+            m_output.push_back('n');
+            break;
+        case '\r':
+            m_output.push_back('r');
+            break;
+        case '\t':
+            m_output.push_back('t');
+            break;
+        default:
+            static const char hexDigits[] = "0123456789abcdef";
+            ASSERT(c < 0x20);
+            m_output.push_back('u');
+            m_output.push_back('0');
+            m_output.push_back('0');
+            m_output.push_back(hexDigits[c >> 4]);
+            m_output.push_back(hexDigits[c & 0xf]);
+            break;
+        }
+    }
+
+    template <typename> friend class JSONStringifier;
+
+    ESVMInstance* m_instance;
+    ESObject* m_objectPrototype;
+    ESObject* m_arrayPrototype;
+    ESString* m_toJSON;
+    bool m_prototypesAreClean;
+    bool m_holesReadAsUndefined;
+    OutputString m_output;
+    // gc allocated, since a cycle error longjmps past the destructor
+    std::vector<ESObject*, gc_allocator<ESObject*> > m_stack;
+    std::unordered_set<ESObject*, std::hash<ESObject*>, std::equal_to<ESObject*>, gc_allocator<ESObject*> > m_stackSet;
+};
+
+bool stringifyJSONFast(ESVMInstance* instance, ESValue value, ESValue& result)
+{
+    JSONStringifier<char> asciiStringifier(instance);
+    switch (asciiStringifier.serialize(value)) {
+    case JSONStringifier<char>::Written:
+        result = ESString::create(std::move(asciiStringifier.output()));
+        return true;
+    case JSONStringifier<char>::Undefined:
+        result = ESValue();
+        return true;
+    case JSONStringifier<char>::Fallback:
+        return false;
+    case JSONStringifier<char>::NeedsUTF16:
+        break;
+    }
+
+    JSONStringifier<char16_t> utf16Stringifier(instance);
+    switch (utf16Stringifier.serialize(value)) {
+    case JSONStringifier<char16_t>::Written:
+        result = ESString::create(std::move(utf16Stringifier.output()));
+        return true;
+    case JSONStringifier<char16_t>::Undefined:
+        result = ESValue();
+        return true;
+    default:
+        return false;
+    }
+}
+
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef JSONStringifier_h
+#define JSONStringifier_h
+
+namespace escargot {
+
+class ESVMInstance;
+
+// JSON.stringify for the common case: no replacer, no gap and no toJSON.
+// Handles plain objects, fast mode arrays and primitives without running any user code.
+// Returns false (having had no observable effect) if the value needs the generic algorithm.
+bool stringifyJSONFast(ESVMInstance* instance, ESValue value, ESValue& result);
+
+}
+
+#endif
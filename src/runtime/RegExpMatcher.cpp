@@ -0,0 +1,799 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "Escargot.h"
+#include "RegExpMatcher.h"
+#include "RegExpPrefilter.h"
+#include "vm/ESVMInstance.h"
+
+#include "Yarr.h"
+
+namespace escargot {
+
+using JSC::Yarr::YarrPattern;
+using JSC::Yarr::PatternDisjunction;
+using JSC::Yarr::PatternAlternative;
+using JSC::Yarr::PatternTerm;
+using JSC::Yarr::CharacterClass;
+
+// the interpreter gives up after this many backtracks too (JSC::Yarr::matchLimit)
+static const size_t RegExpMatcherBacktrackLimit = JSC::Yarr::matchLimit;
+// every backtracking point is a C++ frame, so recursion may use the stack the script has
+// left (see ESVMInstance::stackCheck), less what the interpreter needs once it takes over
+static const size_t RegExpMatcherStackReserve = 256 * options::KB;
+static const size_t RegExpMatcherStackBudget = options::MaxStackDepth - RegExpMatcherStackReserve;
+
+void RegExpCharClass::init(const CharacterClass* characterClass, bool invert)
+{
+    m_class = characterClass;
+    m_invert = invert;
+    memset(m_asciiBits, 0, sizeof(m_asciiBits));
+    for (unsigned c = 0; c < 128; c ++) {
+        bool match = false;
+        for (unsigned i = 0; i < characterClass->m_matches.size() && !match; i ++)
+            match = (c == characterClass->m_matches[i]);
+        for (unsigned i = 0; i < characterClass->m_ranges.size() && !match; i ++)
+            match = (c >= characterClass->m_ranges[i].begin && c <= characterClass->m_ranges[i].end);
+        if (match != invert)
+            m_asciiBits[c >> 5] |= 1u << (c & 31);
+    }
+}
+
+bool RegExpCharClass::testNonASCII(unsigned c) const
+{
+    for (unsigned i = 0; i < m_class->m_matchesUnicode.size(); i ++) {
+        if (c == m_class->m_matchesUnicode[i])
+            return true;
+    }
+    for (unsigned i = 0; i < m_class->m_rangesUnicode.size(); i ++) {
+        if (c >= m_class->m_rangesUnicode[i].begin && c <= m_class->m_rangesUnicode[i].end)
+            return true;
+    }
+    return false;
+}
+
+// a single pattern character (with its other case if ignoreCase) or a character class
+struct RegExpCharTest {
+    ALWAYS_INLINE bool test(unsigned c) const
+    {
+        if (m_isClass)
+            return m_class.test(c);
+        return c == m_char || c == m_otherCaseChar;
+    }
+
+    bool m_isClass;
+    char16_t m_char;
+    char16_t m_otherCaseChar;
+    RegExpCharClass m_class;
+};
+
+struct RegExpNode {
+    enum Type {
+        Accept,
+        Literal,
+        CharLoop,
+        AssertionBOL,
+        AssertionEOL,
+        AssertionWordBoundary,
+        Alternation,
+        CaptureBegin,
+        CaptureEnd,
+        RepeatBegin,
+        RepeatEnd,
+        LookaheadBegin,
+        LookaheadEnd,
+    };
+
+    explicit RegExpNode(Type type)
+        : m_type(type)
+        , m_next(NULL)
+        , m_min(0)
+        , m_max(0)
+        , m_greedy(false)
+        , m_body(NULL)
+        , m_loop(NULL)
+        , m_index(0)
+        , m_firstSubpattern(0)
+        , m_lastSubpattern(0)
+        , m_invert(false)
+    {
+    }
+
+    Type m_type;
+    RegExpNode* m_next;
+
+    // Literal: m_otherCaseChars equals m_chars unless ignoreCase
+    std::vector<char16_t> m_chars;
+    std::vector<char16_t> m_otherCaseChars;
+
+    // CharLoop
+    RegExpCharTest m_charTest;
+    unsigned m_min;
+    unsigned m_max;
+    bool m_greedy;
+
+    // Alternation
+    std::vector<RegExpNode*> m_alternatives;
+
+    // RepeatBegin, LookaheadBegin: m_body ends with the matching RepeatEnd or LookaheadEnd
+    RegExpNode* m_body;
+    // RepeatEnd
+    RegExpNode* m_loop;
+    // capture id for Capture*, loop slot for Repeat*
+    unsigned m_index;
+    // subpatterns reset by each iteration of a repeat, or restored after a lookahead
+    unsigned m_firstSubpattern;
+    unsigned m_lastSubpattern;
+    // AssertionWordBoundary, LookaheadBegin
+    bool m_invert;
+};
+
+class RegExpMatcherCompiler {
+public:
+    RegExpMatcherCompiler(YarrPattern& pattern, RegExpMatcher* matcher)
+        : m_pattern(pattern)
+        , m_matcher(matcher)
+        , m_unsupported(false)
+    {
+    }
+
+    bool compile()
+    {
+        if (m_pattern.m_containsBackreferences)
+            return false;
+
+        m_matcher->m_numSubpatterns = m_pattern.m_numSubpatterns;
+        m_matcher->m_multiline = m_pattern.m_multiline;
+        m_matcher->m_newlineClass.init(m_pattern.newlineCharacterClass(), false);
+        m_matcher->m_wordcharClass.init(m_pattern.wordcharCharacterClass(), false);
+
+        // optimizeBOL appends copies of the alternatives to the body which only differ
+        // in how often the interpreter runs them; the originals are enough here
+        std::vector<PatternAlternative*> alternatives = bodyAlternatives(m_pattern.m_body, true);
+        m_matcher->m_entry = compileAlternatives(alternatives, newNode(RegExpNode::Accept), true);
+
+        unsigned minimumLength = UINT_MAX;
+        bool anchored = !m_pattern.m_multiline;
+        for (size_t i = 0; i < alternatives.size(); i ++) {
+            minimumLength = std::min(minimumLength, this->minimumLength(alternatives[i]));
+            // m_startsWithBOL is also set when a nested group merely contains a leading ^
+            auto& terms = alternatives[i]->m_terms;
+            anchored = anchored && terms.size() && terms[0].type == PatternTerm::TypeAssertionBOL;
+        }
+        m_matcher->m_minimumLength = alternatives.size() ? minimumLength : 0;
+        m_matcher->m_anchoredAtStart = anchored && alternatives.size();
+        return !m_unsupported;
+    }
+
+private:
+    std::vector<PatternAlternative*> bodyAlternatives(PatternDisjunction* disjunction, bool isBody)
+    {
+        std::vector<PatternAlternative*> result;
+        bool hasOnceThrough = false;
+        for (size_t i = 0; i < disjunction->m_alternatives.size(); i ++)
+            hasOnceThrough = hasOnceThrough || disjunction->m_alternatives[i]->onceThrough();
+        for (size_t i = 0; i < disjunction->m_alternatives.size(); i ++) {
+            PatternAlternative* alternative = disjunction->m_alternatives[i];
+            if (!isBody || !hasOnceThrough || alternative->onceThrough())
+                result.push_back(alternative);
+        }
+        return result;
+    }
+
+    RegExpNode* newNode(RegExpNode::Type type, RegExpNode* next = NULL)
+    {
+        RegExpNode* node = new RegExpNode(type);
+        node->m_next = next;
+        m_matcher->m_nodes.push_back(node);
+        return node;
+    }
+
+    RegExpNode* compileAlternatives(const std::vector<PatternAlternative*>& alternatives, RegExpNode* next, bool isBody = false)
+    {
+        if (alternatives.size() == 1)
+            return compileAlternative(alternatives[0], next, isBody);
+
+        RegExpNode* node = newNode(RegExpNode::Alternation, next);
+        for (size_t i = 0; i < alternatives.size(); i ++)
+            node->m_alternatives.push_back(compileAlternative(alternatives[i], next, isBody));
+        if (node->m_alternatives.empty())
+            m_unsupported = true;
+        return node;
+    }
+
+    RegExpNode* compileDisjunction(PatternDisjunction* disjunction, RegExpNode* next)
+    {
+        return compileAlternatives(bodyAlternatives(disjunction, false), next);
+    }
+
+    // terms are compiled back to front so every node knows its continuation.
+    // Runs of fixed pattern characters are merged into one Literal node.
+    RegExpNode* compileAlternative(PatternAlternative* alternative, RegExpNode* next, bool isBody)
+    {
+        RegExpNode* node = next;
+        std::vector<char16_t> chars;
+        std::vector<char16_t> otherCaseChars;
+        for (size_t i = alternative->m_terms.size(); i > 0; i --) {
+            PatternTerm& term = alternative->m_terms[i - 1];
+            if (term.type == PatternTerm::TypePatternCharacter && term.quantityType == JSC::Yarr::QuantifierFixedCount) {
+                RegExpCharTest test = charTest(term);
+                for (unsigned j = 0; j < term.quantityCount.unsafeGet(); j ++) {
+                    chars.push_back(test.m_char);
+                    otherCaseChars.push_back(test.m_otherCaseChar);
+                }
+                continue;
+            }
+            // optimizeBOL rewrites patterns with any other ^ in ways the matcher does not model
+            if (term.type == PatternTerm::TypeAssertionBOL && !m_pattern.m_multiline && !(isBody && i == 1))
+                m_unsupported = true;
+            node = flushLiteral(chars, otherCaseChars, node);
+            node = compileTerm(term, node);
+        }
+        return flushLiteral(chars, otherCaseChars, node);
+    }
+
+    RegExpNode* flushLiteral(std::vector<char16_t>& chars, std::vector<char16_t>& otherCaseChars, RegExpNode* next)
+    {
+        if (chars.empty())
+            return next;
+        RegExpNode* node = newNode(RegExpNode::Literal, next);
+        node->m_chars.assign(chars.rbegin(), chars.rend());
+        node->m_otherCaseChars.assign(otherCaseChars.rbegin(), otherCaseChars.rend());
+        chars.clear();
+        otherCaseChars.clear();
+        return node;
+    }
+
+    RegExpCharTest charTest(PatternTerm& term)
+    {
+        RegExpCharTest test;
+        if (term.type == PatternTerm::TypeCharacterClass) {
+            test.m_isClass = true;
+            test.m_char = test.m_otherCaseChar = 0;
+            test.m_class.init(term.characterClass, term.invert());
+            return test;
+        }
+
+        // same case folding as the bytecode compiler
+        UChar ch = term.patternCharacter;
+        test.m_isClass = false;
+        test.m_char = test.m_otherCaseChar = ch;
+        if (m_pattern.m_ignoreCase) {
+            UChar lo = JSC::Yarr::Unicode::toLower(ch);
+            UChar hi = JSC::Yarr::Unicode::toUpper(ch);
+            if (lo != hi) {
+                test.m_char = lo;
+                test.m_otherCaseChar = hi;
+            }
+        }
+        return test;
+    }
+
+    RegExpNode* compileTerm(PatternTerm& term, RegExpNode* next)
+    {
+        unsigned count = term.quantityCount.unsafeGet();
+        switch (term.type) {
+        case PatternTerm::TypeAssertionBOL:
+            return newNode(RegExpNode::AssertionBOL, next);
+        case PatternTerm::TypeAssertionEOL:
+            return newNode(RegExpNode::AssertionEOL, next);
+        case PatternTerm::TypeAssertionWordBoundary: {
+            RegExpNode* node = newNode(RegExpNode::AssertionWordBoundary, next);
+            node->m_invert = term.invert();
+            return node;
+        }
+        case PatternTerm::TypePatternCharacter:
+        case PatternTerm::TypeCharacterClass: {
+            RegExpNode* node = newNode(RegExpNode::CharLoop, next);
+            node->m_charTest = charTest(term);
+            node->m_min = term.quantityType == JSC::Yarr::QuantifierFixedCount ? count : 0;
+            node->m_max = count;
+            node->m_greedy = term.quantityType != JSC::Yarr::QuantifierNonGreedy;
+            return node;
+        }
+        case PatternTerm::TypeParenthesesSubpattern:
+            return compileParentheses(term, next);
+        case PatternTerm::TypeParentheticalAssertion: {
+            // the interpreter keeps stale captures from inside lookaheads across backtracking,
+            // which the matcher would not reproduce
+            if (term.parentheses.lastSubpatternId >= term.parentheses.subpatternId) {
+                m_unsupported = true;
+                return next;
+            }
+            RegExpNode* node = newNode(RegExpNode::LookaheadBegin, next);
+            node->m_invert = term.invert();
+            node->m_firstSubpattern = term.parentheses.subpatternId;
+            node->m_lastSubpattern = term.parentheses.lastSubpatternId;
+            node->m_body = compileDisjunction(term.parentheses.disjunction, newNode(RegExpNode::LookaheadEnd));
+            return node;
+        }
+        default:
+            // backreferences and the DotStarEnclosure rewrite stay on the interpreter
+            m_unsupported = true;
+            return next;
+        }
+    }
+
+    RegExpNode* compileParentheses(PatternTerm& term, RegExpNode* next)
+    {
+        unsigned count = term.quantityCount.unsafeGet();
+        unsigned subpatternId = term.parentheses.subpatternId;
+        PatternDisjunction* disjunction = term.parentheses.disjunction;
+
+        if (term.quantityType == JSC::Yarr::QuantifierFixedCount && count == 1) {
+            if (!term.capture())
+                return compileDisjunction(disjunction, next);
+            RegExpNode* end = newNode(RegExpNode::CaptureEnd, next);
+            end->m_index = subpatternId;
+            RegExpNode* begin = newNode(RegExpNode::CaptureBegin, compileDisjunction(disjunction, end));
+            begin->m_index = subpatternId;
+            return begin;
+        }
+
+        // the interpreter's handling of empty iterations differs from the spec in places,
+        // so repeats which can match the empty string are left to it
+        if (!minimumLength(disjunction)) {
+            m_unsupported = true;
+            return next;
+        }
+
+        RegExpNode* loop = newNode(RegExpNode::RepeatBegin, next);
+        loop->m_index = m_matcher->m_numLoops++;
+        loop->m_min = term.quantityType == JSC::Yarr::QuantifierFixedCount ? count : 0;
+        loop->m_max = count;
+        loop->m_greedy = term.quantityType != JSC::Yarr::QuantifierNonGreedy;
+        loop->m_firstSubpattern = subpatternId;
+        loop->m_lastSubpattern = term.parentheses.lastSubpatternId;
+
+        RegExpNode* loopEnd = newNode(RegExpNode::RepeatEnd);
+        loopEnd->m_loop = loop;
+        if (term.capture()) {
+            RegExpNode* end = newNode(RegExpNode::CaptureEnd, loopEnd);
+            end->m_index = subpatternId;
+            RegExpNode* begin = newNode(RegExpNode::CaptureBegin, compileDisjunction(disjunction, end));
+            begin->m_index = subpatternId;
+            loop->m_body = begin;
+        } else {
+            loop->m_body = compileDisjunction(disjunction, loopEnd);
+        }
+        return loop;
+    }
+
+    static unsigned saturatingAdd(unsigned a, unsigned b)
+    {
+        return a > UINT_MAX - b ? UINT_MAX : a + b;
+    }
+
+    static unsigned saturatingMultiply(unsigned a, unsigned b)
+    {
+        return (b && a > UINT_MAX / b) ? UINT_MAX : a * b;
+    }
+
+    unsigned minimumLength(PatternDisjunction* disjunction)
+    {
+        std::vector<PatternAlternative*> alternatives = bodyAlternatives(disjunction, false);
+        unsigned result = UINT_MAX;
+        for (size_t i = 0; i < alternatives.size(); i ++)
+            result = std::min(result, minimumLength(alternatives[i]));
+        return alternatives.size() ? result : 0;
+    }
+
+    unsigned minimumLength(PatternAlternative* alternative)
+    {
+        unsigned result = 0;
+        for (size_t i = 0; i < alternative->m_terms.size(); i ++) {
+            PatternTerm& term = alternative->m_terms[i];
+            if (term.quantityType != JSC::Yarr::QuantifierFixedCount)
+                continue;
+            unsigned count = term.quantityCount.unsafeGet();
+            if (term.type == PatternTerm::TypePatternCharacter || term.type == PatternTerm::TypeCharacterClass)
+                result = saturatingAdd(result, count);
+            else if (term.type == PatternTerm::TypeParenthesesSubpattern)
+                result = saturatingAdd(result, saturatingMultiply(count, minimumLength(term.parentheses.disjunction)));
+        }
+        return result;
+    }
+
+    YarrPattern& m_pattern;
+    RegExpMatcher* m_matcher;
+    bool m_unsupported;
+};
+
+RegExpMatcher* RegExpMatcher::compile(YarrPattern& pattern, RegExpPrefilter* prefilter)
+{
+    RegExpMatcher* matcher = new RegExpMatcher();
+    matcher->m_prefilter = prefilter;
+    RegExpMatcherCompiler compiler(pattern, matcher);
+    if (!compiler.compile()) {
+        delete matcher;
+        return NULL;
+    }
+    return matcher;
+}
+
+RegExpMatcher::~RegExpMatcher()
+{
+    for (size_t i = 0; i < m_nodes.size(); i ++)
+        delete m_nodes[i];
+}
+
+size_t RegExpMatcher::memoryUsage()
+{
+    size_t result = sizeof(RegExpMatcher) + m_nodes.capacity() * sizeof(RegExpNode*);
+    for (size_t i = 0; i < m_nodes.size(); i ++) {
+        RegExpNode* node = m_nodes[i];
+        result += sizeof(RegExpNode) + (node->m_chars.capacity() + node->m_otherCaseChars.capacity()) * sizeof(char16_t);
+        result += node->m_alternatives.capacity() * sizeof(RegExpNode*);
+    }
+    return result;
+}
+
+ALWAYS_INLINE unsigned regExpCharAt(const char* input, unsigned index)
+{
+    return (unsigned char)input[index];
+}
+
+ALWAYS_INLINE unsigned regExpCharAt(const char16_t* input, unsigned index)
+{
+    return input[index];
+}
+
+// Matching state for one RegExpMatcher::match call.
+// Nodes which cannot fail after the fact (characters, assertions) are walked in a loop;
+// every backtracking point recurses through matchFrom and undoes its changes if the
+// continuation fails, so captures and loop counters never need a separate trail.
+template <typename CharType>
+class RegExpMatchState {
+public:
+    RegExpMatchState(RegExpMatcher* matcher, const CharType* input, unsigned length, unsigned* output, unsigned* storage)
+        : m_matcher(matcher)
+        , m_input(input)
+        , m_length(length)
+        , m_output(output)
+        , m_captureStarts(storage)
+        , m_loops(reinterpret_cast<LoopState*>(storage + matcher->m_numSubpatterns + 1))
+        , m_matchEnd(0)
+        , m_remainingBacktracks(RegExpMatcherBacktrackLimit)
+        , m_aborted(false)
+    {
+        char dummy;
+        m_stackStart = &dummy;
+        if (ESVMInstance* instance = ESVMInstance::currentInstance())
+            m_stackStart = instance->stackStart();
+    }
+
+    bool matchFrom(const RegExpNode* node, unsigned pos)
+    {
+        char dummy;
+        if (UNLIKELY(m_aborted || static_cast<size_t>(m_stackStart - &dummy) > RegExpMatcherStackBudget || !m_remainingBacktracks)) {
+            m_aborted = true;
+            return false;
+        }
+        m_remainingBacktracks--;
+        return matchNodes(node, pos);
+    }
+
+    unsigned matchEnd() { return m_matchEnd; }
+    bool aborted() { return m_aborted; }
+
+    // cheap check of the first character before recursing into a continuation
+    ALWAYS_INLINE bool mayMatchAt(const RegExpNode* node, unsigned pos)
+    {
+        if (node->m_type == RegExpNode::Literal)
+            return pos < m_length && (charAt(pos) == node->m_chars[0] || charAt(pos) == node->m_otherCaseChars[0]);
+        if (node->m_type == RegExpNode::CharLoop && node->m_min)
+            return pos < m_length && node->m_charTest.test(charAt(pos));
+        return true;
+    }
+
+private:
+    struct LoopState {
+        unsigned m_count;
+        unsigned m_iterationStart;
+    };
+
+    ALWAYS_INLINE unsigned charAt(unsigned pos)
+    {
+        return regExpCharAt(m_input, pos);
+    }
+
+    bool isNewline(unsigned pos)
+    {
+        return m_matcher->m_newlineClass.test(charAt(pos));
+    }
+
+    bool isWordchar(unsigned pos)
+    {
+        return m_matcher->m_wordcharClass.test(charAt(pos));
+    }
+
+    size_t saveSubpatterns(unsigned first, unsigned last)
+    {
+        size_t mark = m_saved.size();
+        for (unsigned i = first; i <= last; i ++) {
+            m_saved.push_back(m_output[i * 2]);
+            m_saved.push_back(m_output[i * 2 + 1]);
+        }
+        return mark;
+    }
+
+    void clearSubpatterns(unsigned first, unsigned last)
+    {
+        for (unsigned i = first; i <= last; i ++)
+            m_output[i * 2] = m_output[i * 2 + 1] = JSC::Yarr::offsetNoMatch;
+    }
+
+    void restoreSubpatterns(unsigned first, unsigned last, size_t mark)
+    {
+        for (unsigned i = first; i <= last; i ++) {
+            m_output[i * 2] = m_saved[mark + (i - first) * 2];
+            m_output[i * 2 + 1] = m_saved[mark + (i - first) * 2 + 1];
+        }
+    }
+
+    // ES5.1 15.10.2.5 RepeatMatcher, with the iteration count in m_loops
+    bool matchRepeat(const RegExpNode* loop, unsigned pos)
+    {
+        LoopState& state = m_loops[loop->m_index];
+        unsigned count = state.m_count;
+        if (count == loop->m_max)
+            return matchFrom(loop->m_next, pos);
+        if (count < loop->m_min)
+            return matchIteration(loop, pos);
+        if (loop->m_greedy) {
+            if (matchIteration(loop, pos))
+                return true;
+            return matchFrom(loop->m_next, pos);
+        }
+        if (matchFrom(loop->m_next, pos))
+            return true;
+        return matchIteration(loop, pos);
+    }
+
+    bool matchIteration(const RegExpNode* loop, unsigned pos)
+    {
+        LoopState& state = m_loops[loop->m_index];
+        unsigned first = loop->m_firstSubpattern;
+        unsigned last = loop->m_lastSubpattern;
+        size_t mark = saveSubpatterns(first, last);
+        clearSubpatterns(first, last);
+        unsigned savedStart = state.m_iterationStart;
+        state.m_iterationStart = pos;
+        bool result = matchFrom(loop->m_body, pos);
+        state.m_iterationStart = savedStart;
+        if (!result)
+            restoreSubpatterns(first, last, mark);
+        m_saved.resize(mark);
+        return result;
+    }
+
+    bool matchNodes(const RegExpNode* node, unsigned pos)
+    {
+        while (true) {
+            switch (node->m_type) {
+            case RegExpNode::Accept:
+                m_matchEnd = pos;
+                return true;
+            case RegExpNode::Literal: {
+                size_t length = node->m_chars.size();
+                if (m_length - pos < length)
+                    return false;
+                const char16_t* chars = node->m_chars.data();
+                const char16_t* otherCaseChars = node->m_otherCaseChars.data();
+                for (size_t i = 0; i < length; i ++) {
+                    unsigned c = charAt(pos + i);
+                    if (c != chars[i] && c != otherCaseChars[i])
+                        return false;
+                }
+                pos += length;
+                node = node->m_next;
+                break;
+            }
+            case RegExpNode::CharLoop: {
+                const RegExpCharTest& test = node->m_charTest;
+                unsigned min = node->m_min;
+                unsigned available = m_length - pos;
+                if (available < min)
+                    return false;
+                unsigned max = std::min(node->m_max, available);
+                unsigned count = 0;
+                if (min == node->m_max || node->m_greedy) {
+                    while (count < max && test.test(charAt(pos + count)))
+                        count ++;
+                    if (count < min)
+                        return false;
+                    const RegExpNode* next = node->m_next;
+                    if (next->m_type == RegExpNode::Accept) {
+                        m_matchEnd = pos + count;
+                        return true;
+                    }
+                    for (; count > min; count --) {
+                        if (mayMatchAt(next, pos + count) && matchFrom(next, pos + count))
+                            return true;
+                        if (m_aborted)
+                            return false;
+                    }
+                    pos += min;
+                    node = next;
+                    break;
+                }
+                for (; count < min; count ++) {
+                    if (!test.test(charAt(pos + count)))
+                        return false;
+                }
+                while (true) {
+                    if (mayMatchAt(node->m_next, pos + count) && matchFrom(node->m_next, pos + count))
+                        return true;
+                    if (m_aborted || count == max || !test.test(charAt(pos + count)))
+                        return false;
+                    count ++;
+                }
+            }
+            case RegExpNode::AssertionBOL:
+                if (pos && !(m_matcher->m_multiline && isNewline(pos - 1)))
+                    return false;
+                node = node->m_next;
+                break;
+            case RegExpNode::AssertionEOL:
+                if (pos < m_length && !(m_matcher->m_multiline && isNewline(pos)))
+                    return false;
+                node = node->m_next;
+                break;
+            case RegExpNode::AssertionWordBoundary: {
+                bool prevIsWordchar = pos && isWordchar(pos - 1);
+                bool readIsWordchar = pos < m_length && isWordchar(pos);
+                if ((prevIsWordchar != readIsWordchar) == node->m_invert)
+                    return false;
+                node = node->m_next;
+                break;
+            }
+            case RegExpNode::Alternation: {
+                size_t last = node->m_alternatives.size() - 1;
+                for (size_t i = 0; i < last; i ++) {
+                    if (matchFrom(node->m_alternatives[i], pos))
+                        return true;
+                    if (m_aborted)
+                        return false;
+                }
+                node = node->m_alternatives[last];
+                break;
+            }
+            case RegExpNode::CaptureBegin: {
+                unsigned savedStart = m_captureStarts[node->m_index];
+                m_captureStarts[node->m_index] = pos;
+                if (matchFrom(node->m_next, pos))
+                    return true;
+                m_captureStarts[node->m_index] = savedStart;
+                return false;
+            }
+            case RegExpNode::CaptureEnd: {
+                unsigned* capture = m_output + node->m_index * 2;
+                unsigned savedStart = capture[0];
+                unsigned savedEnd = capture[1];
+                capture[0] = m_captureStarts[node->m_index];
+                capture[1] = pos;
+                if (matchFrom(node->m_next, pos))
+                    return true;
+                capture[0] = savedStart;
+                capture[1] = savedEnd;
+                return false;
+            }
+            case RegExpNode::RepeatBegin: {
+                LoopState& state = m_loops[node->m_index];
+                LoopState saved = state;
+                state.m_count = 0;
+                bool result = matchRepeat(node, pos);
+                m_loops[node->m_index] = saved;
+                return result;
+            }
+            case RegExpNode::RepeatEnd: {
+                const RegExpNode* loop = node->m_loop;
+                LoopState& state = m_loops[loop->m_index];
+                unsigned count = state.m_count;
+                if (count >= loop->m_min && pos == state.m_iterationStart)
+                    return false;
+                state.m_count = count + 1;
+                bool result = matchRepeat(loop, pos);
+                m_loops[loop->m_index].m_count = count;
+                return result;
+            }
+            case RegExpNode::LookaheadBegin: {
+                unsigned first = node->m_firstSubpattern;
+                unsigned last = node->m_lastSubpattern;
+                size_t mark = saveSubpatterns(first, last);
+                bool result = matchFrom(node->m_body, pos);
+                if (m_aborted)
+                    return false;
+                if (result != node->m_invert) {
+                    if (matchFrom(node->m_next, pos)) {
+                        m_saved.resize(mark);
+                        return true;
+                    }
+                }
+                restoreSubpatterns(first, last, mark);
+                m_saved.resize(mark);
+                return false;
+            }
+            case RegExpNode::LookaheadEnd:
+                return true;
+            }
+        }
+    }
+
+    RegExpMatcher* m_matcher;
+    const CharType* m_input;
+    unsigned m_length;
+    unsigned* m_output;
+    unsigned* m_captureStarts;
+    LoopState* m_loops;
+    std::vector<unsigned> m_saved;
+    unsigned m_matchEnd;
+    char* m_stackStart;
+    size_t m_remainingBacktracks;
+    bool m_aborted;
+};
+
+template <typename CharType>
+RegExpMatcher::MatchResult RegExpMatcher::matchImpl(const CharType* input, unsigned length, unsigned start, unsigned* output)
+{
+    for (unsigned i = 0; i < (m_numSubpatterns + 1) * 2; i ++)
+        output[i] = JSC::Yarr::offsetNoMatch;
+    if (start > length)
+        return NoMatch;
+
+    unsigned inlineStorage[32];
+    std::vector<unsigned> heapStorage;
+    size_t storageSize = m_numSubpatterns + 1 + m_numLoops * 2;
+    unsigned* storage = inlineStorage;
+    if (storageSize > 32) {
+        heapStorage.resize(storageSize);
+        storage = heapStorage.data();
+    }
+
+    RegExpMatchState<CharType> state(this, input, length, output, storage);
+    for (unsigned pos = start; length - pos >= m_minimumLength; pos ++) {
+        if (m_prefilter && !m_anchoredAtStart) {
+            size_t candidate = m_prefilter->findCandidate(input, length, pos);
+            if (candidate == SIZE_MAX || length - candidate < m_minimumLength)
+                break;
+            pos = candidate;
+        }
+        if (state.mayMatchAt(m_entry, pos)) {
+            if (state.matchFrom(m_entry, pos)) {
+                output[0] = pos;
+                output[1] = state.matchEnd();
+                return Match;
+            }
+            if (state.aborted())
+                return NeedsInterpreter;
+        }
+        if (m_anchoredAtStart || pos == length)
+            break;
+    }
+    return NoMatch;
+}
+
+RegExpMatcher::MatchResult RegExpMatcher::match(const char* input, unsigned length, unsigned start, unsigned* output)
+{
+    return matchImpl(input, length, start, output);
+}
+
+RegExpMatcher::MatchResult RegExpMatcher::match(const char16_t* input, unsigned length, unsigned start, unsigned* output)
+{
+    return matchImpl(input, length, start, output);
+}
+
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef RegExpMatcher_h
+#define RegExpMatcher_h
+
+namespace JSC {
+namespace Yarr {
+class YarrPattern;
+struct PatternDisjunction;
+struct PatternAlternative;
+struct PatternTerm;
+struct CharacterClass;
+}
+}
+
+namespace escargot {
+
+struct RegExpNode;
+class RegExpPrefilter;
+
+// A Yarr CharacterClass with its ASCII part (and the inversion) folded into a bitmap
+struct RegExpCharClass {
+    void init(const JSC::Yarr::CharacterClass* characterClass, bool invert);
+
+    ALWAYS_INLINE bool test(unsigned c) const
+    {
+        if (LIKELY(c < 128))
+            return m_asciiBits[c >> 5] & (1u << (c & 31));
+        return testNonASCII(c) != m_invert;
+    }
+
+    bool testNonASCII(unsigned c) const;
+
+    uint32_t m_asciiBits[4];
+    const JSC::Yarr::CharacterClass* m_class;
+    bool m_invert;
+};
+
+// Backtracking matcher compiled from a YarrPattern into a graph of specialized nodes.
+// It runs without the per-term frames and bytecode dispatch of JSC::Yarr::interpret,
+// and produces the same output layout (start/end pairs, offsetNoMatch if unset).
+// Patterns using backreferences or other constructs it does not know are rejected
+// by compile() and stay on the interpreter.
+// Like the Yarr patterns it is compiled from, it is finalized by the GC once no
+// ESRegExpObject or regexp cache entry refers to it.
+class RegExpMatcher : public gc_cleanup {
+public:
+    enum MatchResult {
+        NoMatch,
+        Match,
+        // backtracking or recursion limit reached; the caller has to rerun the interpreter
+        NeedsInterpreter,
+    };
+
+    // returns NULL if the pattern has to be run by the interpreter.
+    // prefilter (which may be NULL) is used to skip to candidate start positions
+    static RegExpMatcher* compile(JSC::Yarr::YarrPattern& pattern, RegExpPrefilter* prefilter);
+    ~RegExpMatcher();
+
+    MatchResult match(const char* input, unsigned length, unsigned start, unsigned* output);
+    MatchResult match(const char16_t* input, unsigned length, unsigned start, unsigned* output);
+
+    unsigned numSubpatterns() { return m_numSubpatterns; }
+    size_t memoryUsage();
+
+private:
+    friend class RegExpMatcherCompiler;
+    template <typename CharType> friend class RegExpMatchState;
+
+    RegExpMatcher()
+        : m_entry(NULL)
+        , m_prefilter(NULL)
+        , m_numSubpatterns(0)
+        , m_numLoops(0)
+        , m_minimumLength(0)
+        , m_multiline(false)
+        , m_anchoredAtStart(false)
+    {
+    }
+
+    template <typename CharType>
+    MatchResult matchImpl(const CharType* input, unsigned length, unsigned start, unsigned* output);
+
+    std::vector<RegExpNode*> m_nodes;
+    RegExpNode* m_entry;
+    RegExpPrefilter* m_prefilter;
+    unsigned m_numSubpatterns;
+    unsigned m_numLoops;
+    unsigned m_minimumLength;
+    RegExpCharClass m_newlineClass;
+    RegExpCharClass m_wordcharClass;
+    bool m_multiline;
+    // every alternative starts with ^ (not multiline), so only the first start position can match
+    bool m_anchoredAtStart;
+};
+
+}
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "Escargot.h"
+#include "RegExpPrefilter.h"
+#include "StringOperations.h"
+
+#include "Yarr.h"
+
+namespace escargot {
+
+using JSC::Yarr::YarrPattern;
+using JSC::Yarr::PatternDisjunction;
+using JSC::Yarr::PatternAlternative;
+using JSC::Yarr::PatternTerm;
+using JSC::Yarr::CharacterClass;
+
+class RegExpPrefilterBuilder {
+public:
+    enum FirstChars {
+        // every path consumes a character from the collected set first
+        Consumed,
+        // some path reaches the end without consuming anything
+        MayBeEmpty,
+        // the pattern uses something the builder does not look through
+        Unknown,
+    };
+
+    RegExpPrefilterBuilder(YarrPattern& pattern, RegExpPrefilter* prefilter)
+        : m_pattern(pattern)
+        , m_prefilter(prefilter)
+    {
+    }
+
+    bool build()
+    {
+        // all alternatives of the body, including the copies made by optimizeBOL,
+        // so the set is a superset of what the interpreter can start with
+        if (collectFirstChars(m_pattern.m_body) != Consumed)
+            return false;
+
+        if (m_pattern.m_body->m_alternatives.size() == 1)
+            collectPrefix(m_pattern.m_body->m_alternatives[0]);
+
+        unsigned asciiCount = 0;
+        for (unsigned i = 0; i < 4; i ++)
+            asciiCount += __builtin_popcount(m_prefilter->m_asciiFirstChars[i]);
+        unsigned count = asciiCount + m_prefilter->m_nonASCIIFirstChars.size();
+        if (!m_prefilter->m_anyNonASCIIFirstChar && count && count <= 2) {
+            unsigned index = 0;
+            for (unsigned c = 0; c < 128; c ++) {
+                if (m_prefilter->isFirstChar(c))
+                    m_prefilter->m_charPair[index++] = c;
+            }
+            for (size_t i = 0; i < m_prefilter->m_nonASCIIFirstChars.size(); i ++)
+                m_prefilter->m_charPair[index++] = m_prefilter->m_nonASCIIFirstChars[i];
+            if (index == 1)
+                m_prefilter->m_charPair[1] = m_prefilter->m_charPair[0];
+            m_prefilter->m_searchCharPair = true;
+        }
+
+        // a set this wide skips almost nothing, and costs a lookup per character
+        if (m_prefilter->m_anyNonASCIIFirstChar && asciiCount > 64 && m_prefilter->m_prefix.size() < 2)
+            return false;
+        return true;
+    }
+
+private:
+    FirstChars collectFirstChars(PatternDisjunction* disjunction)
+    {
+        FirstChars result = Consumed;
+        for (size_t i = 0; i < disjunction->m_alternatives.size(); i ++) {
+            FirstChars alternative = collectFirstChars(disjunction->m_alternatives[i]);
+            if (alternative == Unknown)
+                return Unknown;
+            if (alternative == MayBeEmpty)
+                result = MayBeEmpty;
+        }
+        return result;
+    }
+
+    FirstChars collectFirstChars(PatternAlternative* alternative)
+    {
+        for (size_t i = 0; i < alternative->m_terms.size(); i ++) {
+            PatternTerm& term = alternative->m_terms[i];
+            bool consumes = term.quantityType == JSC::Yarr::QuantifierFixedCount && term.quantityCount.unsafeGet();
+            switch (term.type) {
+            case PatternTerm::TypeAssertionBOL:
+            case PatternTerm::TypeAssertionEOL:
+            case PatternTerm::TypeAssertionWordBoundary:
+            case PatternTerm::TypeParentheticalAssertion:
+                // zero-width; ignoring what they require only makes the set larger
+                break;
+            case PatternTerm::TypePatternCharacter:
+                addPatternCharacter(term.patternCharacter);
+                if (consumes)
+                    return Consumed;
+                break;
+            case PatternTerm::TypeCharacterClass:
+                addCharacterClass(term.characterClass, term.invert());
+                if (consumes)
+                    return Consumed;
+                break;
+            case PatternTerm::TypeParenthesesSubpattern: {
+                FirstChars group = collectFirstChars(term.parentheses.disjunction);
+                if (group == Unknown)
+                    return Unknown;
+                if (group == Consumed && consumes)
+                    return Consumed;
+                break;
+            }
+            default:
+                return Unknown;
+            }
+        }
+        return MayBeEmpty;
+    }
+
+    // same case folding as the bytecode compiler
+    void foldCase(UChar ch, char16_t& lower, char16_t& upper)
+    {
+        lower = upper = ch;
+        if (m_pattern.m_ignoreCase) {
+            UChar lo = JSC::Yarr::Unicode::toLower(ch);
+            UChar hi = JSC::Yarr::Unicode::toUpper(ch);
+            if (lo != hi) {
+                lower = lo;
+                upper = hi;
+            }
+        }
+    }
+
+    void addChar(unsigned c)
+    {
+        if (c < 128)
+            m_prefilter->m_asciiFirstChars[c >> 5] |= 1u << (c & 31);
+        else if (!m_prefilter->isFirstChar(c))
+            m_prefilter->m_nonASCIIFirstChars.push_back(c);
+    }
+
+    void addPatternCharacter(UChar ch)
+    {
+        char16_t lower, upper;
+        foldCase(ch, lower, upper);
+        addChar(lower);
+        addChar(upper);
+    }
+
+    void addCharacterClass(const CharacterClass* characterClass, bool invert)
+    {
+        for (unsigned c = 0; c < 128; c ++) {
+            bool match = false;
+            for (unsigned i = 0; i < characterClass->m_matches.size() && !match; i ++)
+                match = (c == characterClass->m_matches[i]);
+            for (unsigned i = 0; i < characterClass->m_ranges.size() && !match; i ++)
+                match = (c >= characterClass->m_ranges[i].begin && c <= characterClass->m_ranges[i].end);
+            if (match != invert)
+                addChar(c);
+        }
+        if (invert || characterClass->m_rangesUnicode.size() || characterClass->m_matchesUnicode.size() > 8) {
+            m_prefilter->m_anyNonASCIIFirstChar = true;
+            return;
+        }
+        for (unsigned i = 0; i < characterClass->m_matchesUnicode.size(); i ++)
+            addChar(characterClass->m_matchesUnicode[i]);
+    }
+
+    // the fixed characters an alternative starts with, after any zero-width assertions
+    void collectPrefix(PatternAlternative* alternative)
+    {
+        bool isLiteral = true;
+        size_t i = 0;
+        for (; i < alternative->m_terms.size(); i ++) {
+            PatternTerm::Type type = alternative->m_terms[i].type;
+            if (type != PatternTerm::TypeAssertionBOL && type != PatternTerm::TypeAssertionEOL
+                && type != PatternTerm::TypeAssertionWordBoundary && type != PatternTerm::TypeParentheticalAssertion)
+                break;
+            isLiteral = false;
+        }
+        for (; i < alternative->m_terms.size(); i ++) {
+            PatternTerm& term = alternative->m_terms[i];
+            if (term.type != PatternTerm::TypePatternCharacter || term.quantityType != JSC::Yarr::QuantifierFixedCount) {
+                isLiteral = false;
+                break;
+            }
+            char16_t lower, upper;
+            foldCase(term.patternCharacter, lower, upper);
+            for (unsigned j = 0; j < term.quantityCount.unsafeGet(); j ++) {
+                m_prefilter->m_prefix.push_back(lower);
+                m_prefilter->m_otherCasePrefix.push_back(upper);
+            }
+        }
+        m_prefilter->m_isLiteral = isLiteral && m_prefilter->m_prefix.size() && !m_pattern.m_numSubpatterns;
+    }
+
+    YarrPattern& m_pattern;
+    RegExpPrefilter* m_prefilter;
+};
+
+RegExpPrefilter* RegExpPrefilter::create(YarrPattern& pattern)
+{
+    RegExpPrefilter* prefilter = new RegExpPrefilter();
+    RegExpPrefilterBuilder builder(pattern, prefilter);
+    if (!builder.build()) {
+        delete prefilter;
+        return NULL;
+    }
+    return prefilter;
+}
+
+ALWAYS_INLINE unsigned regExpPrefilterCharAt(const char* input, size_t index)
+{
+    return (unsigned char)input[index];
+}
+
+ALWAYS_INLINE unsigned regExpPrefilterCharAt(const char16_t* input, size_t index)
+{
+    return input[index];
+}
+
+// ASCII strings cannot contain the non-ASCII half of a pair
+ALWAYS_INLINE size_t findFirstCharPair(const char* input, size_t length, char16_t a, char16_t b)
+{
+    if (a >= 128 && b >= 128)
+        return length;
+    if (a >= 128)
+        a = b;
+    else if (b >= 128)
+        b = a;
+    return findCharPair(input, length, (char)a, (char)b);
+}
+
+ALWAYS_INLINE size_t findFirstCharPair(const char16_t* input, size_t length, char16_t a, char16_t b)
+{
+    return findCharPair(input, length, a, b);
+}
+
+template <typename CharType>
+size_t RegExpPrefilter::findCandidateImpl(const CharType* input, size_t length, size_t start)
+{
+    size_t prefixLength = m_prefix.size();
+    for (size_t pos = start; pos < length && length - pos >= prefixLength; pos ++) {
+        if (m_searchCharPair) {
+            pos += findFirstCharPair(input + pos, length - pos, m_charPair[0], m_charPair[1]);
+        } else {
+            while (pos < length && !isFirstChar(regExpPrefilterCharAt(input, pos)))
+                pos++;
+        }
+        if (length - pos < prefixLength || pos == length)
+            return SIZE_MAX;
+
+        size_t i = 0;
+        for (; i < prefixLength; i ++) {
+            unsigned c = regExpPrefilterCharAt(input, pos + i);
+            if (c != m_prefix[i] && c != m_otherCasePrefix[i])
+                break;
+        }
+        if (i == prefixLength)
+            return pos;
+    }
+    return SIZE_MAX;
+}
+
+size_t RegExpPrefilter::findCandidate(const char* input, size_t length, size_t start)
+{
+    return findCandidateImpl(input, length, start);
+}
+
+size_t RegExpPrefilter::findCandidate(const char16_t* input, size_t length, size_t start)
+{
+    return findCandidateImpl(input, length, start);
+}
+
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef RegExpPrefilter_h
+#define RegExpPrefilter_h
+
+namespace JSC {
+namespace Yarr {
+class YarrPattern;
+}
+}
+
+namespace escargot {
+
+// What a YarrPattern requires at the position where a match begins:
+// the set of possible first characters and, if the pattern has a single alternative,
+// the literal characters it starts with. Used to skip to candidate positions
+// before running a matcher, and to match purely literal patterns without Yarr at all.
+class RegExpPrefilter : public gc_cleanup {
+public:
+    // returns NULL if any position could start a match (e.g. the pattern can match the empty string)
+    static RegExpPrefilter* create(JSC::Yarr::YarrPattern& pattern);
+
+    // the first position >= start where a match can begin, or SIZE_MAX
+    size_t findCandidate(const char* input, size_t length, size_t start);
+    size_t findCandidate(const char16_t* input, size_t length, size_t start);
+
+    // the whole pattern is the literal prefix (no captures, classes or assertions)
+    bool isLiteral() { return m_isLiteral; }
+
+    size_t memoryUsage()
+    {
+        return sizeof(RegExpPrefilter) + (m_prefix.capacity() + m_otherCasePrefix.capacity() + m_nonASCIIFirstChars.capacity()) * sizeof(char16_t);
+    }
+
+    // same contract as JSC::Yarr::interpret for literal patterns
+    template <typename CharType>
+    unsigned matchLiteral(const CharType* input, unsigned length, unsigned start, unsigned* output)
+    {
+        ASSERT(m_isLiteral);
+        size_t found = findCandidate(input, length, start);
+        if (found == SIZE_MAX) {
+            output[0] = output[1] = (unsigned)-1;
+            return (unsigned)-1;
+        }
+        output[0] = found;
+        output[1] = found + m_prefix.size();
+        return found;
+    }
+
+private:
+    friend class RegExpPrefilterBuilder;
+
+    RegExpPrefilter()
+        : m_anyNonASCIIFirstChar(false)
+        , m_searchCharPair(false)
+        , m_isLiteral(false)
+    {
+        memset(m_asciiFirstChars, 0, sizeof(m_asciiFirstChars));
+    }
+
+    template <typename CharType>
+    size_t findCandidateImpl(const CharType* input, size_t length, size_t start);
+
+    bool isFirstChar(unsigned c)
+    {
+        if (c < 128)
+            return m_asciiFirstChars[c >> 5] & (1u << (c & 31));
+        return m_anyNonASCIIFirstChar || std::find(m_nonASCIIFirstChars.begin(), m_nonASCIIFirstChars.end(), c) != m_nonASCIIFirstChars.end();
+    }
+
+    // m_otherCasePrefix equals m_prefix unless the pattern ignores case
+    std::vector<char16_t> m_prefix;
+    std::vector<char16_t> m_otherCasePrefix;
+
+    uint32_t m_asciiFirstChars[4];
+    std::vector<char16_t> m_nonASCIIFirstChars;
+    bool m_anyNonASCIIFirstChar;
+
+    // at most two possible first characters, searched with findCharPair
+    bool m_searchCharPair;
+    char16_t m_charPair[2];
+
+    bool m_isLiteral;
+};
+
+}
+
+#endif
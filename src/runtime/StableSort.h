@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef StableSort_h
+#define StableSort_h
+
+namespace escargot {
+
+// A simplified TimSort, used where lessThan may run user code.
+// Natural runs are found (descending ones reversed) and extended to a minimum length
+// with binary insertion sort, then merged keeping the run length invariants of TimSort,
+// so sorted, reversed and partially sorted inputs take close to n comparisons.
+//
+// Every access stays in bounds whatever lessThan answers, so an inconsistent comparator
+// only gives an unspecified order. The merge buffer is GC memory: it can hold the only
+// reference to a value while lessThan runs, and a throw (longjmp) skips destructors.
+template <typename T, typename LessThan>
+class StableSort {
+public:
+    static void sort(T* data, size_t length, const LessThan& lessThan)
+    {
+        StableSort sorter(data, length, lessThan);
+        sorter.sort();
+    }
+
+private:
+    StableSort(T* data, size_t length, const LessThan& lessThan)
+        : m_data(data)
+        , m_length(length)
+        , m_lessThan(lessThan)
+        , m_runCount(0)
+    {
+    }
+
+    struct Run {
+        size_t m_start;
+        size_t m_length;
+    };
+
+    void sort()
+    {
+        if (m_length < 2)
+            return;
+        size_t minRun = computeMinRun(m_length);
+        size_t start = 0;
+        while (start < m_length) {
+            size_t end = findRun(start);
+            if (end - start < minRun) {
+                size_t forcedEnd = std::min(m_length, start + minRun);
+                binaryInsertionSort(start, end, forcedEnd);
+                end = forcedEnd;
+            }
+            RELEASE_ASSERT(m_runCount < MaxRunCount);
+            m_runs[m_runCount++] = Run { start, end - start };
+            mergeCollapse();
+            start = end;
+        }
+        while (m_runCount > 1) {
+            size_t n = m_runCount - 2;
+            if (n > 0 && m_runs[n - 1].m_length < m_runs[n + 1].m_length)
+                n--;
+            mergeAt(n);
+        }
+    }
+
+    static size_t computeMinRun(size_t length)
+    {
+        size_t r = 0;
+        while (length >= 64) {
+            r |= length & 1;
+            length >>= 1;
+        }
+        return length + r;
+    }
+
+    // the end of the run beginning at start
+    size_t findRun(size_t start)
+    {
+        size_t end = start + 1;
+        if (end == m_length)
+            return end;
+        if (m_lessThan(m_data[end], m_data[start])) {
+            // strictly descending, so reversing it keeps the sort stable
+            end++;
+            while (end < m_length && m_lessThan(m_data[end], m_data[end - 1]))
+                end++;
+            std::reverse(m_data + start, m_data + end);
+        } else {
+            end++;
+            while (end < m_length && !m_lessThan(m_data[end], m_data[end - 1]))
+                end++;
+        }
+        return end;
+    }
+
+    // [start, sorted) is sorted already
+    void binaryInsertionSort(size_t start, size_t sorted, size_t end)
+    {
+        for (size_t i = sorted; i < end; i ++) {
+            T pivot = m_data[i];
+            size_t position = upperBound(m_data + start, i - start, pivot) + start;
+            std::copy_backward(m_data + position, m_data + i, m_data + i + 1);
+            m_data[position] = pivot;
+        }
+    }
+
+    // the first index whose element is greater than value
+    size_t upperBound(const T* data, size_t length, const T& value)
+    {
+        size_t lo = 0, hi = length;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (m_lessThan(value, data[mid]))
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        return lo;
+    }
+
+    // the first index whose element is not less than value
+    size_t lowerBound(const T* data, size_t length, const T& value)
+    {
+        size_t lo = 0, hi = length;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (m_lessThan(data[mid], value))
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    void mergeCollapse()
+    {
+        while (m_runCount > 1) {
+            size_t n = m_runCount - 2;
+            if ((n > 0 && m_runs[n - 1].m_length <= m_runs[n].m_length + m_runs[n + 1].m_length)
+                || (n > 1 && m_runs[n - 2].m_length <= m_runs[n - 1].m_length + m_runs[n].m_length)) {
+                if (m_runs[n - 1].m_length < m_runs[n + 1].m_length)
+                    n--;
+            } else if (m_runs[n].m_length > m_runs[n + 1].m_length) {
+                return;
+            }
+            mergeAt(n);
+        }
+    }
+
+    void mergeAt(size_t n)
+    {
+        merge(m_runs[n].m_start, m_runs[n].m_length, m_runs[n + 1].m_length);
+        m_runs[n].m_length += m_runs[n + 1].m_length;
+        for (size_t i = n + 1; i < m_runCount - 1; i ++)
+            m_runs[i] = m_runs[i + 1];
+        m_runCount--;
+    }
+
+    void merge(size_t start, size_t leftLength, size_t rightLength)
+    {
+        T* left = m_data + start;
+        T* right = left + leftLength;
+
+        // the head of the left run and the tail of the right run are in place already
+        T firstOfRight = right[0];
+        size_t skip = upperBound(left, leftLength, firstOfRight);
+        left += skip;
+        leftLength -= skip;
+        if (!leftLength)
+            return;
+        T lastOfLeft = left[leftLength - 1];
+        rightLength = lowerBound(right, rightLength, lastOfLeft);
+        if (!rightLength)
+            return;
+
+        m_buffer.assign(left, left + leftLength);
+        T* out = left;
+        size_t i = 0, j = 0;
+        while (i < leftLength && j < rightLength) {
+            // equal elements are taken from the left run first
+            if (m_lessThan(right[j], m_buffer[i]))
+                *out++ = right[j++];
+            else
+                *out++ = m_buffer[i++];
+        }
+        // what is left of the right run is in place
+        while (i < leftLength)
+            *out++ = m_buffer[i++];
+    }
+
+    // enough for any length, given the invariants kept by mergeCollapse
+    static const size_t MaxRunCount = 85;
+
+    T* m_data;
+    size_t m_length;
+    const LessThan& m_lessThan;
+    Run m_runs[MaxRunCount];
+    size_t m_runCount;
+    std::vector<T, gc_allocator<T> > m_buffer;
+};
+
+template <typename T, typename LessThan>
+inline void stableSort(T* data, size_t length, const LessThan& lessThan)
+{
+    StableSort<T, LessThan>::sort(data, length, lessThan);
+}
+
+}
+
+#endif
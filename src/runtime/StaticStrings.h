@@ -153,6 +153,7 @@ class ESString;
     F(compile) \
     F(byteLength) \
     F(subarray) \
+    F(copyWithin) \
     F(buffer) \
     F(JSON) \
     F(parse) \
@@ -0,0 +1,712 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "Escargot.h"
+#include "StringOperations.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define ESCARGOT_STRING_OPERATIONS_SSE2
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && !defined(ESCARGOT_SMALL_CONFIG)
+#include <immintrin.h>
+#define ESCARGOT_STRING_OPERATIONS_AVX2
+#endif
+#endif
+
+namespace escargot {
+
+static size_t asciiPrefixLength8Scalar(const char* src, size_t len)
+{
+    size_t i = 0;
+    // check a word at a time
+    for (; i + sizeof(size_t) <= len; i += sizeof(size_t)) {
+        size_t w;
+        memcpy(&w, src + i, sizeof(size_t));
+        if (w & (size_t)0x8080808080808080ULL)
+            break;
+    }
+    for (; i < len; i ++) {
+        if (src[i] & 0x80)
+            return i;
+    }
+    return len;
+}
+
+static size_t asciiPrefixLength16Scalar(const char16_t* src, size_t len)
+{
+    for (size_t i = 0; i < len; i ++) {
+        if (src[i] >= 128)
+            return i;
+    }
+    return len;
+}
+
+static void narrowASCIIScalar(const char16_t* src, size_t len, char* dst)
+{
+    for (size_t i = 0; i < len; i ++) {
+        ASSERT(src[i] < 128);
+        dst[i] = src[i];
+    }
+}
+
+static void widenASCIIScalar(const char* src, size_t len, char16_t* dst)
+{
+    for (size_t i = 0; i < len; i ++) {
+        dst[i] = (unsigned char)src[i];
+    }
+}
+
+static void asciiToLowerScalar(const char* src, size_t len, char* dst)
+{
+    for (size_t i = 0; i < len; i ++) {
+        char c = src[i];
+        dst[i] = (c >= 'A' && c <= 'Z') ? (c | 0x20) : c;
+    }
+}
+
+static void asciiToUpperScalar(const char* src, size_t len, char* dst)
+{
+    for (size_t i = 0; i < len; i ++) {
+        char c = src[i];
+        dst[i] = (c >= 'a' && c <= 'z') ? (c & ~0x20) : c;
+    }
+}
+
+static size_t mismatch8Scalar(const char* a, const char* b, size_t len)
+{
+    size_t i = 0;
+    for (; i + sizeof(size_t) <= len; i += sizeof(size_t)) {
+        size_t wa, wb;
+        memcpy(&wa, a + i, sizeof(size_t));
+        memcpy(&wb, b + i, sizeof(size_t));
+        if (wa != wb)
+            break;
+    }
+    for (; i < len; i ++) {
+        if (a[i] != b[i])
+            return i;
+    }
+    return len;
+}
+
+static size_t mismatch16Scalar(const char16_t* a, const char16_t* b, size_t len)
+{
+    for (size_t i = 0; i < len; i ++) {
+        if (a[i] != b[i])
+            return i;
+    }
+    return len;
+}
+
+static size_t mismatch8To16Scalar(const char* a, const char16_t* b, size_t len)
+{
+    for (size_t i = 0; i < len; i ++) {
+        if ((unsigned char)a[i] != b[i])
+            return i;
+    }
+    return len;
+}
+
+static size_t jsonSafePrefixLength8Scalar(const char* src, size_t len)
+{
+    for (size_t i = 0; i < len; i ++) {
+        if (needsJSONEscape(src[i]))
+            return i;
+    }
+    return len;
+}
+
+static size_t jsonSafePrefixLength16Scalar(const char16_t* src, size_t len)
+{
+    for (size_t i = 0; i < len; i ++) {
+        if (needsJSONEscape(src[i]))
+            return i;
+    }
+    return len;
+}
+
+static size_t findCharPair8Scalar(const char* src, size_t len, char a, char b)
+{
+    for (size_t i = 0; i < len; i ++) {
+        if (src[i] == a || src[i] == b)
+            return i;
+    }
+    return len;
+}
+
+static size_t findCharPair16Scalar(const char16_t* src, size_t len, char16_t a, char16_t b)
+{
+    for (size_t i = 0; i < len; i ++) {
+        if (src[i] == a || src[i] == b)
+            return i;
+    }
+    return len;
+}
+
+// leaves everything to the caller's sequence at a time decoder
+static size_t decodeUTF8Scalar(const char* src, size_t len, char16_t* dst, size_t* dstLength)
+{
+    *dstLength = 0;
+    return 0;
+}
+
+#ifdef ESCARGOT_STRING_OPERATIONS_SSE2
+static size_t asciiPrefixLength8SSE2(const char* src, size_t len)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(src + i)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + asciiPrefixLength8Scalar(src + i, len - i);
+}
+
+static size_t asciiPrefixLength16SSE2(const char16_t* src, size_t len)
+{
+    const __m128i nonASCIIBits = _mm_set1_epi16((short)0xff80);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(src + i)), nonASCIIBits);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(v, zero));
+        if (mask != 0xffff)
+            return i + (__builtin_ctz(~mask) >> 1);
+    }
+    return i + asciiPrefixLength16Scalar(src + i, len - i);
+}
+
+static void narrowASCIISSE2(const char16_t* src, size_t len, char* dst)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i hi = _mm_loadu_si128((const __m128i*)(src + i + 8));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    narrowASCIIScalar(src + i, len - i, dst + i);
+}
+
+static void widenASCIISSE2(const char* src, size_t len, char16_t* dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+    widenASCIIScalar(src + i, len - i, dst + i);
+}
+
+// signed compare is fine here: bytes >= 0x80 are negative, so they never fall in [from, to]
+template <char from, char to, bool toLower>
+static void asciiCaseMapSSE2(const char* src, size_t len, char* dst)
+{
+    const __m128i lowerBound = _mm_set1_epi8(from - 1);
+    const __m128i upperBound = _mm_set1_epi8(to + 1);
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i inRange = _mm_and_si128(_mm_cmpgt_epi8(v, lowerBound), _mm_cmplt_epi8(v, upperBound));
+        __m128i flip = _mm_and_si128(inRange, caseBit);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(v, flip));
+    }
+    if (toLower)
+        asciiToLowerScalar(src + i, len - i, dst + i);
+    else
+        asciiToUpperScalar(src + i, len - i, dst + i);
+}
+
+static size_t mismatch8SSE2(const char* a, const char* b, size_t len)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+        if (mask != 0xffff)
+            return i + __builtin_ctz(~mask);
+    }
+    return i + mismatch8Scalar(a + i, b + i, len - i);
+}
+
+static size_t mismatch16SSE2(const char16_t* a, const char16_t* b, size_t len)
+{
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(va, vb));
+        if (mask != 0xffff)
+            return i + (__builtin_ctz(~mask) >> 1);
+    }
+    return i + mismatch16Scalar(a + i, b + i, len - i);
+}
+
+static size_t mismatch8To16SSE2(const char* a, const char16_t* b, size_t len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i va = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(a + i)), zero);
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi16(va, vb));
+        if (mask != 0xffff)
+            return i + (__builtin_ctz(~mask) >> 1);
+    }
+    return i + mismatch8To16Scalar(a + i, b + i, len - i);
+}
+
+// a byte is a control character iff max(v, 0x1f) == 0x1f (unsigned)
+static size_t jsonSafePrefixLength8SSE2(const char* src, size_t len)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i controlMax = _mm_set1_epi8(0x1f);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i escape = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash));
+        escape = _mm_or_si128(escape, _mm_cmpeq_epi8(_mm_max_epu8(v, controlMax), controlMax));
+        int mask = _mm_movemask_epi8(escape);
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + jsonSafePrefixLength8Scalar(src + i, len - i);
+}
+
+// a code unit is a control character iff saturating (v - 0x1f) == 0
+static size_t jsonSafePrefixLength16SSE2(const char16_t* src, size_t len)
+{
+    const __m128i quote = _mm_set1_epi16('"');
+    const __m128i backslash = _mm_set1_epi16('\\');
+    const __m128i controlMax = _mm_set1_epi16(0x1f);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i escape = _mm_or_si128(_mm_cmpeq_epi16(v, quote), _mm_cmpeq_epi16(v, backslash));
+        escape = _mm_or_si128(escape, _mm_cmpeq_epi16(_mm_subs_epu16(v, controlMax), zero));
+        int mask = _mm_movemask_epi8(escape);
+        if (mask)
+            return i + (__builtin_ctz(mask) >> 1);
+    }
+    return i + jsonSafePrefixLength16Scalar(src + i, len - i);
+}
+
+static size_t findCharPair8SSE2(const char* src, size_t len, char a, char b)
+{
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+    return i + findCharPair8Scalar(src + i, len - i, a, b);
+}
+
+static size_t findCharPair16SSE2(const char16_t* src, size_t len, char16_t a, char16_t b)
+{
+    const __m128i va = _mm_set1_epi16(a);
+    const __m128i vb = _mm_set1_epi16(b);
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(v, va), _mm_cmpeq_epi16(v, vb)));
+        if (mask)
+            return i + (__builtin_ctz(mask) >> 1);
+    }
+    return i + findCharPair16Scalar(src + i, len - i, a, b);
+}
+#endif
+
+#ifdef ESCARGOT_STRING_OPERATIONS_AVX2
+// Each kernel clears the upper halves of the ymm registers before handing the tail to SSE2 or
+// scalar code. GCC does not always emit vzeroupper there, and dirty upper state makes every
+// legacy SSE instruction run afterwards, anywhere in the process, pay a transition penalty.
+
+__attribute__((target("avx2")))
+static size_t asciiPrefixLength8AVX2(const char* src, size_t len)
+{
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        unsigned mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(src + i)));
+        if (mask) {
+            _mm256_zeroupper();
+            return i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + asciiPrefixLength8SSE2(src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t asciiPrefixLength16AVX2(const char16_t* src, size_t len)
+{
+    const __m256i nonASCIIBits = _mm256_set1_epi16((short)0xff80);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(src + i)), nonASCIIBits);
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(v, zero));
+        if (mask != 0xffffffffu) {
+            _mm256_zeroupper();
+            return i + (__builtin_ctz(~mask) >> 1);
+        }
+    }
+    _mm256_zeroupper();
+    return i + asciiPrefixLength16SSE2(src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static void narrowASCIIAVX2(const char16_t* src, size_t len, char* dst)
+{
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i lo = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i*)(src + i + 16));
+        // packus works per 128-bit lane, so restore the element order afterwards
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xd8);
+        _mm256_storeu_si256((__m256i*)(dst + i), packed);
+    }
+    _mm256_zeroupper();
+    narrowASCIISSE2(src + i, len - i, dst + i);
+}
+
+__attribute__((target("avx2")))
+static void widenASCIIAVX2(const char* src, size_t len, char16_t* dst)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_cvtepu8_epi16(v));
+    }
+    _mm256_zeroupper();
+    widenASCIIScalar(src + i, len - i, dst + i);
+}
+
+template <char from, char to, bool toLower>
+__attribute__((target("avx2")))
+static void asciiCaseMapAVX2(const char* src, size_t len, char* dst)
+{
+    const __m256i lowerBound = _mm256_set1_epi8(from - 1);
+    const __m256i upperBound = _mm256_set1_epi8(to + 1);
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i inRange = _mm256_and_si256(_mm256_cmpgt_epi8(v, lowerBound), _mm256_cmpgt_epi8(upperBound, v));
+        __m256i flip = _mm256_and_si256(inRange, caseBit);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(v, flip));
+    }
+    _mm256_zeroupper();
+    asciiCaseMapSSE2<from, to, toLower>(src + i, len - i, dst + i);
+}
+
+__attribute__((target("avx2")))
+static size_t mismatch8AVX2(const char* a, const char* b, size_t len)
+{
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+        if (mask != 0xffffffffu) {
+            _mm256_zeroupper();
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + mismatch8SSE2(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t mismatch16AVX2(const char16_t* a, const char16_t* b, size_t len)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(va, vb));
+        if (mask != 0xffffffffu) {
+            _mm256_zeroupper();
+            return i + (__builtin_ctz(~mask) >> 1);
+        }
+    }
+    _mm256_zeroupper();
+    return i + mismatch16SSE2(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t mismatch8To16AVX2(const char* a, const char16_t* b, size_t len)
+{
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(a + i)));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(b + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi16(va, vb));
+        if (mask != 0xffffffffu) {
+            _mm256_zeroupper();
+            return i + (__builtin_ctz(~mask) >> 1);
+        }
+    }
+    _mm256_zeroupper();
+    return i + mismatch8To16SSE2(a + i, b + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t jsonSafePrefixLength8AVX2(const char* src, size_t len)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i controlMax = _mm256_set1_epi8(0x1f);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i escape = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash));
+        escape = _mm256_or_si256(escape, _mm256_cmpeq_epi8(_mm256_max_epu8(v, controlMax), controlMax));
+        unsigned mask = _mm256_movemask_epi8(escape);
+        if (mask) {
+            _mm256_zeroupper();
+            return i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + jsonSafePrefixLength8SSE2(src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t jsonSafePrefixLength16AVX2(const char16_t* src, size_t len)
+{
+    const __m256i quote = _mm256_set1_epi16('"');
+    const __m256i backslash = _mm256_set1_epi16('\\');
+    const __m256i controlMax = _mm256_set1_epi16(0x1f);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i escape = _mm256_or_si256(_mm256_cmpeq_epi16(v, quote), _mm256_cmpeq_epi16(v, backslash));
+        escape = _mm256_or_si256(escape, _mm256_cmpeq_epi16(_mm256_subs_epu16(v, controlMax), zero));
+        unsigned mask = _mm256_movemask_epi8(escape);
+        if (mask) {
+            _mm256_zeroupper();
+            return i + (__builtin_ctz(mask) >> 1);
+        }
+    }
+    _mm256_zeroupper();
+    return i + jsonSafePrefixLength16SSE2(src + i, len - i);
+}
+
+__attribute__((target("avx2")))
+static size_t findCharPair8AVX2(const char* src, size_t len, char a, char b)
+{
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)));
+        if (mask) {
+            _mm256_zeroupper();
+            return i + __builtin_ctz(mask);
+        }
+    }
+    _mm256_zeroupper();
+    return i + findCharPair8SSE2(src + i, len - i, a, b);
+}
+
+__attribute__((target("avx2")))
+static size_t findCharPair16AVX2(const char16_t* src, size_t len, char16_t a, char16_t b)
+{
+    const __m256i va = _mm256_set1_epi16(a);
+    const __m256i vb = _mm256_set1_epi16(b);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi16(v, va), _mm256_cmpeq_epi16(v, vb)));
+        if (mask) {
+            _mm256_zeroupper();
+            return i + (__builtin_ctz(mask) >> 1);
+        }
+    }
+    _mm256_zeroupper();
+    return i + findCharPair16SSE2(src + i, len - i, a, b);
+}
+
+// pshufb masks that pack the 16-bit lanes selected by an 8-bit mask to the front
+static uint8_t s_packUTF16LanesShuffle[256][16];
+
+static void initializePackUTF16LanesShuffle()
+{
+    for (unsigned mask = 0; mask < 256; mask ++) {
+        unsigned j = 0;
+        for (unsigned lane = 0; lane < 8; lane ++) {
+            if (mask & (1 << lane)) {
+                s_packUTF16LanesShuffle[mask][j++] = lane * 2;
+                s_packUTF16LanesShuffle[mask][j++] = lane * 2 + 1;
+            }
+        }
+        for (; j < 16; j ++)
+            s_packUTF16LanesShuffle[mask][j] = 0x80;
+    }
+}
+
+// Works on 16 byte blocks of three kinds, each checked to be well-formed before it is decoded:
+// ASCII, any mix of ASCII and two byte sequences, and five three byte sequences in a row.
+// Whatever else it meets (four byte sequences, overlong forms, surrogates, bad bytes) is left
+// to the caller, whose decoder also decides what replaces malformed input.
+__attribute__((target("avx2")))
+static size_t decodeUTF8AVX2(const char* src, size_t len, char16_t* dst, size_t* dstLength)
+{
+    const __m128i continuationBits = _mm_set1_epi8((char)0xc0);
+    const __m128i continuationTag = _mm_set1_epi8((char)0x80);
+    const __m128i twoByteLeadMin = _mm_set1_epi8((char)0xc2);
+    const __m128i twoByteLeadRange = _mm_set1_epi8(0xdf - 0xc2);
+    const __m128i threeByteLeadBits = _mm_set1_epi8((char)0xf0);
+    const __m128i threeByteLeadTag = _mm_set1_epi8((char)0xe0);
+    const __m128i threeByteLeads = _mm_setr_epi8(0, -1, 3, -1, 6, -1, 9, -1, 12, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i threeByteFirstContinuations = _mm_setr_epi8(1, -1, 4, -1, 7, -1, 10, -1, 13, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i threeByteSecondContinuations = _mm_setr_epi8(2, -1, 5, -1, 8, -1, 11, -1, 14, -1, -1, -1, -1, -1, -1, -1);
+    size_t i = 0;
+    size_t written = 0;
+    while (i + 16 <= len) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        unsigned nonASCII = _mm_movemask_epi8(v);
+        if (!nonASCII) {
+            _mm256_storeu_si256((__m256i*)(dst + written), _mm256_cvtepu8_epi16(v));
+            i += 16;
+            written += 16;
+            continue;
+        }
+
+        unsigned continuations = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, continuationBits), continuationTag));
+        __m128i offsetFromLeadMin = _mm_sub_epi8(v, twoByteLeadMin);
+        __m128i isTwoByteLead = _mm_cmpeq_epi8(_mm_min_epu8(offsetFromLeadMin, twoByteLeadRange), offsetFromLeadMin);
+        unsigned twoByteLeads = _mm_movemask_epi8(isTwoByteLead);
+        if (!(nonASCII & ~(continuations | twoByteLeads))) {
+            // every lead is followed by a continuation and every continuation follows a lead;
+            // a lead in the last byte is left for the next block
+            if (continuations != ((twoByteLeads << 1) & 0xffff))
+                break;
+            unsigned blockMask = (twoByteLeads & 0x8000) ? 0x7fff : 0xffff;
+            __m256i bytes = _mm256_cvtepu8_epi16(v);
+            __m256i nextBytes = _mm256_cvtepu8_epi16(_mm_srli_si128(v, 1));
+            __m256i twoByteValues = _mm256_or_si256(_mm256_slli_epi16(_mm256_and_si256(bytes, _mm256_set1_epi16(0x1f)), 6),
+                _mm256_and_si256(nextBytes, _mm256_set1_epi16(0x3f)));
+            __m256i values = _mm256_blendv_epi8(bytes, twoByteValues, _mm256_cvtepi8_epi16(isTwoByteLead));
+            unsigned keep = ~continuations & blockMask;
+            __m128i low = _mm_shuffle_epi8(_mm256_castsi256_si128(values), _mm_loadu_si128((const __m128i*)s_packUTF16LanesShuffle[keep & 0xff]));
+            __m128i high = _mm_shuffle_epi8(_mm256_extracti128_si256(values, 1), _mm_loadu_si128((const __m128i*)s_packUTF16LanesShuffle[keep >> 8]));
+            _mm_storeu_si128((__m128i*)(dst + written), low);
+            written += __builtin_popcount(keep & 0xff);
+            _mm_storeu_si128((__m128i*)(dst + written), high);
+            written += __builtin_popcount(keep >> 8);
+            i += (blockMask == 0xffff) ? 16 : 15;
+            continue;
+        }
+
+        unsigned threeByteLeadMask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(v, threeByteLeadBits), threeByteLeadTag));
+        if ((threeByteLeadMask & 0x7fff) == 0x1249 && (continuations & 0x7fff) == 0x6db6) {
+            __m128i leads = _mm_and_si128(_mm_shuffle_epi8(v, threeByteLeads), _mm_set1_epi16(0x0f));
+            __m128i first = _mm_and_si128(_mm_shuffle_epi8(v, threeByteFirstContinuations), _mm_set1_epi16(0x3f));
+            __m128i second = _mm_and_si128(_mm_shuffle_epi8(v, threeByteSecondContinuations), _mm_set1_epi16(0x3f));
+            __m128i values = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(leads, 12), _mm_slli_epi16(first, 6)), second);
+            __m128i topBits = _mm_and_si128(values, _mm_set1_epi16((short)0xf800));
+            __m128i overlongOrSurrogate = _mm_or_si128(_mm_cmpeq_epi16(topBits, _mm_setzero_si128()), _mm_cmpeq_epi16(topBits, _mm_set1_epi16((short)0xd800)));
+            if (_mm_movemask_epi8(overlongOrSurrogate) & 0x3ff)
+                break;
+            _mm_storeu_si128((__m128i*)(dst + written), values);
+            i += 15;
+            written += 5;
+            continue;
+        }
+        break;
+    }
+    _mm256_zeroupper();
+    *dstLength = written;
+    return i;
+}
+#endif
+
+// constant-initialized, so it is usable from other static initializers before selectStringOperations runs
+StringOperationsTable stringOperations = {
+    asciiPrefixLength8Scalar,
+    asciiPrefixLength16Scalar,
+    narrowASCIIScalar,
+    widenASCIIScalar,
+    asciiToLowerScalar,
+    asciiToUpperScalar,
+    mismatch8Scalar,
+    mismatch16Scalar,
+    mismatch8To16Scalar,
+    jsonSafePrefixLength8Scalar,
+    jsonSafePrefixLength16Scalar,
+    findCharPair8Scalar,
+    findCharPair16Scalar,
+    decodeUTF8Scalar,
+    "scalar"
+};
+
+static bool selectStringOperations()
+{
+#ifdef ESCARGOT_STRING_OPERATIONS_SSE2
+    stringOperations.m_asciiPrefixLength8 = asciiPrefixLength8SSE2;
+    stringOperations.m_asciiPrefixLength16 = asciiPrefixLength16SSE2;
+    stringOperations.m_narrowASCII = narrowASCIISSE2;
+    stringOperations.m_widenASCII = widenASCIISSE2;
+    stringOperations.m_asciiToLower = asciiCaseMapSSE2<'A', 'Z', true>;
+    stringOperations.m_asciiToUpper = asciiCaseMapSSE2<'a', 'z', false>;
+    stringOperations.m_mismatch8 = mismatch8SSE2;
+    stringOperations.m_mismatch16 = mismatch16SSE2;
+    stringOperations.m_mismatch8To16 = mismatch8To16SSE2;
+    stringOperations.m_jsonSafePrefixLength8 = jsonSafePrefixLength8SSE2;
+    stringOperations.m_jsonSafePrefixLength16 = jsonSafePrefixLength16SSE2;
+    stringOperations.m_findCharPair8 = findCharPair8SSE2;
+    stringOperations.m_findCharPair16 = findCharPair16SSE2;
+    stringOperations.m_name = "sse2";
+#endif
+#ifdef ESCARGOT_STRING_OPERATIONS_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        stringOperations.m_asciiPrefixLength8 = asciiPrefixLength8AVX2;
+        stringOperations.m_asciiPrefixLength16 = asciiPrefixLength16AVX2;
+        stringOperations.m_narrowASCII = narrowASCIIAVX2;
+        stringOperations.m_widenASCII = widenASCIIAVX2;
+        stringOperations.m_asciiToLower = asciiCaseMapAVX2<'A', 'Z', true>;
+        stringOperations.m_asciiToUpper = asciiCaseMapAVX2<'a', 'z', false>;
+        stringOperations.m_mismatch8 = mismatch8AVX2;
+        stringOperations.m_mismatch16 = mismatch16AVX2;
+        stringOperations.m_mismatch8To16 = mismatch8To16AVX2;
+        stringOperations.m_jsonSafePrefixLength8 = jsonSafePrefixLength8AVX2;
+        stringOperations.m_jsonSafePrefixLength16 = jsonSafePrefixLength16AVX2;
+        stringOperations.m_findCharPair8 = findCharPair8AVX2;
+        stringOperations.m_findCharPair16 = findCharPair16AVX2;
+        initializePackUTF16LanesShuffle();
+        stringOperations.m_decodeUTF8 = decodeUTF8AVX2;
+        stringOperations.m_name = "avx2";
+    }
+#endif
+    return true;
+}
+
+static bool s_stringOperationsSelected = selectStringOperations();
+
+}
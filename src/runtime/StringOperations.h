@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef StringOperations_h
+#define StringOperations_h
+
+namespace escargot {
+
+// Bulk operations over character buffers.
+// Every entry has a scalar implementation and, on x86, SSE2/AVX2 implementations
+// which are selected once at startup by CPU feature (see StringOperations.cpp).
+struct StringOperationsTable {
+    // returns the index of the first non-ASCII character (or len)
+    size_t (*m_asciiPrefixLength8)(const char* src, size_t len);
+    size_t (*m_asciiPrefixLength16)(const char16_t* src, size_t len);
+    // src must be all ASCII
+    void (*m_narrowASCII)(const char16_t* src, size_t len, char* dst);
+    void (*m_widenASCII)(const char* src, size_t len, char16_t* dst);
+    // ASCII-only case mapping. src and dst may be the same buffer
+    void (*m_asciiToLower)(const char* src, size_t len, char* dst);
+    void (*m_asciiToUpper)(const char* src, size_t len, char* dst);
+    // returns the index of the first position where a and b differ (or len)
+    size_t (*m_mismatch8)(const char* a, const char* b, size_t len);
+    size_t (*m_mismatch16)(const char16_t* a, const char16_t* b, size_t len);
+    size_t (*m_mismatch8To16)(const char* a, const char16_t* b, size_t len);
+    // returns the index of the first character JSON.stringify has to escape (or len)
+    size_t (*m_jsonSafePrefixLength8)(const char* src, size_t len);
+    size_t (*m_jsonSafePrefixLength16)(const char16_t* src, size_t len);
+    // returns the index of the first occurrence of a or b (or len)
+    size_t (*m_findCharPair8)(const char* src, size_t len, char a, char b);
+    size_t (*m_findCharPair16)(const char16_t* src, size_t len, char16_t a, char16_t b);
+    // decodes well-formed UTF-8 from the start of src for as long as the kernel can, and returns
+    // the bytes consumed (possibly 0). *dstLength gets the code units written. dst must have room for len
+    size_t (*m_decodeUTF8)(const char* src, size_t len, char16_t* dst, size_t* dstLength);
+    const char* m_name;
+};
+
+extern StringOperationsTable stringOperations;
+
+// buffers shorter than this are handled inline without dispatch
+static const size_t StringOperationsInlineThreshold = 16;
+
+ALWAYS_INLINE size_t asciiPrefixLength(const char* src, size_t len)
+{
+    if (len < StringOperationsInlineThreshold) {
+        for (size_t i = 0; i < len; i ++) {
+            if (src[i] & 0x80)
+                return i;
+        }
+        return len;
+    }
+    return stringOperations.m_asciiPrefixLength8(src, len);
+}
+
+ALWAYS_INLINE size_t asciiPrefixLength(const char16_t* src, size_t len)
+{
+    if (len < StringOperationsInlineThreshold) {
+        for (size_t i = 0; i < len; i ++) {
+            if (src[i] >= 128)
+                return i;
+        }
+        return len;
+    }
+    return stringOperations.m_asciiPrefixLength16(src, len);
+}
+
+ALWAYS_INLINE void narrowASCII(const char16_t* src, size_t len, char* dst)
+{
+    if (len < StringOperationsInlineThreshold) {
+        for (size_t i = 0; i < len; i ++) {
+            ASSERT(src[i] < 128);
+            dst[i] = src[i];
+        }
+        return;
+    }
+    stringOperations.m_narrowASCII(src, len, dst);
+}
+
+ALWAYS_INLINE void widenASCII(const char* src, size_t len, char16_t* dst)
+{
+    if (len < StringOperationsInlineThreshold) {
+        for (size_t i = 0; i < len; i ++) {
+            dst[i] = (unsigned char)src[i];
+        }
+        return;
+    }
+    stringOperations.m_widenASCII(src, len, dst);
+}
+
+ALWAYS_INLINE void asciiToLower(const char* src, size_t len, char* dst)
+{
+    stringOperations.m_asciiToLower(src, len, dst);
+}
+
+ALWAYS_INLINE void asciiToUpper(const char* src, size_t len, char* dst)
+{
+    stringOperations.m_asciiToUpper(src, len, dst);
+}
+
+template <typename T1, typename T2>
+ALWAYS_INLINE size_t stringMismatchInline(const T1* a, const T2* b, size_t len)
+{
+    for (size_t i = 0; i < len; i ++) {
+        if ((typename std::make_unsigned<T1>::type)a[i] != (typename std::make_unsigned<T2>::type)b[i])
+            return i;
+    }
+    return len;
+}
+
+ALWAYS_INLINE size_t stringMismatch(const char* a, const char* b, size_t len)
+{
+    if (len < StringOperationsInlineThreshold)
+        return stringMismatchInline(a, b, len);
+    return stringOperations.m_mismatch8(a, b, len);
+}
+
+ALWAYS_INLINE size_t stringMismatch(const char16_t* a, const char16_t* b, size_t len)
+{
+    if (len < StringOperationsInlineThreshold)
+        return stringMismatchInline(a, b, len);
+    return stringOperations.m_mismatch16(a, b, len);
+}
+
+ALWAYS_INLINE size_t stringMismatch(const char* a, const char16_t* b, size_t len)
+{
+    if (len < StringOperationsInlineThreshold)
+        return stringMismatchInline(a, b, len);
+    return stringOperations.m_mismatch8To16(a, b, len);
+}
+
+ALWAYS_INLINE size_t stringMismatch(const char16_t* a, const char* b, size_t len)
+{
+    return stringMismatch(b, a, len);
+}
+
+template <typename T>
+ALWAYS_INLINE bool needsJSONEscape(T c)
+{
+    return c == '"' || c == '\\' || (typename std::make_unsigned<T>::type)c < 0x20;
+}
+
+ALWAYS_INLINE size_t jsonSafePrefixLength(const char* src, size_t len)
+{
+    if (len < StringOperationsInlineThreshold) {
+        for (size_t i = 0; i < len; i ++) {
+            if (needsJSONEscape(src[i]))
+                return i;
+        }
+        return len;
+    }
+    return stringOperations.m_jsonSafePrefixLength8(src, len);
+}
+
+ALWAYS_INLINE size_t jsonSafePrefixLength(const char16_t* src, size_t len)
+{
+    if (len < StringOperationsInlineThreshold) {
+        for (size_t i = 0; i < len; i ++) {
+            if (needsJSONEscape(src[i]))
+                return i;
+        }
+        return len;
+    }
+    return stringOperations.m_jsonSafePrefixLength16(src, len);
+}
+
+ALWAYS_INLINE size_t findCharPair(const char* src, size_t len, char a, char b)
+{
+    if (a == b) {
+        const void* found = memchr(src, a, len);
+        return found ? (const char*)found - src : len;
+    }
+    if (len < StringOperationsInlineThreshold) {
+        for (size_t i = 0; i < len; i ++) {
+            if (src[i] == a || src[i] == b)
+                return i;
+        }
+        return len;
+    }
+    return stringOperations.m_findCharPair8(src, len, a, b);
+}
+
+ALWAYS_INLINE size_t findCharPair(const char16_t* src, size_t len, char16_t a, char16_t b)
+{
+    if (len < StringOperationsInlineThreshold) {
+        for (size_t i = 0; i < len; i ++) {
+            if (src[i] == a || src[i] == b)
+                return i;
+        }
+        return len;
+    }
+    return stringOperations.m_findCharPair16(src, len, a, b);
+}
+
+ALWAYS_INLINE size_t decodeUTF8(const char* src, size_t len, char16_t* dst, size_t* dstLength)
+{
+    if (len < StringOperationsInlineThreshold) {
+        *dstLength = 0;
+        return 0;
+    }
+    return stringOperations.m_decodeUTF8(src, len, dst, dstLength);
+}
+
+}
+
+#endif
@@ -17,6 +17,8 @@
 #include "Escargot.h"
 #include "vm/ESVMInstance.h"
 #include "runtime/ESValue.h"
+#include "runtime/JSONParser.h"
+#include "runtime/JSONStringifier.h"
 #include "shell/DefaultJobQueue.h"
 #include "ast/AST.h"
 
@@ -27,6 +29,8 @@
 #include <stdio.h>
 #endif
 
+#include <sys/wait.h>
+
 #if defined(ENABLE_ESJIT) && !defined(NDEBUG)
 #include "lirasm.cpp"
 #endif
@@ -58,6 +62,29 @@ void dumpStats()
     stat = GC_get_gc_no();
     fwprintf(stream, L"[BOEHM] gc_no: %d\n", stat);
 
+    escargot::InternalAtomicStringMapStatistics atomicStat = escargot::ESVMInstance::currentInstance()->atomicStringMapStatistics();
+    fwprintf(stream, L"[ATOMIC] entries: %d\n", (int)atomicStat.m_entryCount);
+    fwprintf(stream, L"[ATOMIC] buckets: %d\n", (int)atomicStat.m_bucketCount);
+    fwprintf(stream, L"[ATOMIC] collided_buckets: %d\n", (int)atomicStat.m_collidedBucketCount);
+    fwprintf(stream, L"[ATOMIC] longest_chain: %d\n", (int)atomicStat.m_longestChainLength);
+    fwprintf(stream, L"[ATOMIC] swept_entries: %d\n", (int)atomicStat.m_sweptEntryCount);
+
+    escargot::NumberToStringCacheStatistics numberStat = escargot::ESVMInstance::currentInstance()->numberToStringCacheStatistics();
+    fwprintf(stream, L"[NUMBER_TO_STRING] cache_hit: %d\n", (int)numberStat.m_hitCount);
+    fwprintf(stream, L"[NUMBER_TO_STRING] cache_miss: %d\n", (int)numberStat.m_missCount);
+
+    escargot::GCPauseStatistics pauseStat = escargot::ESVMInstance::gcPauseStatistics();
+    fwprintf(stream, L"[GC] pauses: %d\n", (int)pauseStat.m_pauseCount);
+    fwprintf(stream, L"[GC] total_pause_us: %d\n", (int)pauseStat.m_totalPauseTime);
+    fwprintf(stream, L"[GC] max_pause_us: %d\n", (int)pauseStat.m_maxPauseTime);
+
+    escargot::RegExpCacheStatistics regexpStat = escargot::ESVMInstance::currentInstance()->regexpCacheStatistics();
+    fwprintf(stream, L"[REGEXP] cache_entries: %d\n", (int)regexpStat.m_entryCount);
+    fwprintf(stream, L"[REGEXP] cache_bytes: %d\n", (int)regexpStat.m_bytes);
+    fwprintf(stream, L"[REGEXP] compiles: %d\n", (int)regexpStat.m_compileCount);
+    fwprintf(stream, L"[REGEXP] cache_hit: %d\n", (int)regexpStat.m_hitCount);
+    fwprintf(stream, L"[REGEXP] cache_evicted: %d\n", (int)regexpStat.m_evictedCount);
+
     struct rusage ru;
     getrusage(RUSAGE_SELF, &ru);
     stat = ru.ru_maxrss;
@@ -169,6 +196,56 @@ bool evaluate(escargot::ESVMInstance* instance, escargot::ESString* str, bool pr
     return true;
 }
 
+void dumpHeapProfile(const char* path, escargot::HeapProfiler::Metric metric)
+{
+    if (!path)
+        return;
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "ERROR: Cannot open %s\n", path);
+        return;
+    }
+    escargot::HeapProfiler::dumpFoldedStacks(fp, metric);
+    fclose(fp);
+}
+
+// reads a UTF-8 JSON file in pieces through the embedder stream parser, and prints it back
+bool parseJSONFile(escargot::ESVMInstance* instance, const char* path)
+{
+    FILE* fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "ERROR: Cannot open %s\n", path);
+        return false;
+    }
+    // the parser reads the chunks in place, so they are freed only after finish()
+    std::vector<char*> chunks;
+    escargot::JSONStreamParser parser = instance->createJSONStreamParser();
+    while (true) {
+        char* chunk = (char*)malloc(4096);
+        size_t length = fread(chunk, 1, 4096, fp);
+        chunks.push_back(chunk);
+        parser.appendChunk(chunk, length);
+        if (length < 4096)
+            break;
+    }
+    fclose(fp);
+
+    escargot::ESValue value;
+    bool parsed = parser.finish(value);
+    for (size_t i = 0; i < chunks.size(); i ++)
+        free(chunks[i]);
+    if (!parsed) {
+        printf("SyntaxError: %s (at byte %zu)\n", parser.errorMessage(), parser.errorOffset());
+        return false;
+    }
+    escargot::ESValue text;
+    if (escargot::stringifyJSONFast(instance, value, text))
+        escargot::ESVMInstance::printValue(text);
+    else
+        escargot::ESVMInstance::printValue(value);
+    return true;
+}
+
 int main(int argc, char* argv[])
 {
 #ifdef PROFILE_MASSIF
@@ -283,6 +360,32 @@ int main(int argc, char* argv[])
         return lirasm_main(argc-2, &argv[2]);
     }
 #endif
+    // the collector is configured before the first allocation made by the instance
+    escargot::GCConfiguration gcConfiguration;
+    const char* heapProfilePath = NULL;
+    const char* liveHeapProfilePath = NULL;
+    size_t heapProfileInterval = 512 * 1024;
+    for (int i = 1; i < argc; i ++) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "-gc-incremental") == 0)
+            gcConfiguration.m_incremental = true;
+        else if (hasValue && strcmp(argv[i], "-gc-markers") == 0)
+            gcConfiguration.m_markerThreadCount = atoi(argv[++i]);
+        else if (hasValue && strcmp(argv[i], "-gc-full-freq") == 0)
+            gcConfiguration.m_fullCollectionFrequency = atoi(argv[++i]);
+        else if (hasValue && strcmp(argv[i], "-gc-free-space-divisor") == 0)
+            gcConfiguration.m_freeSpaceDivisor = atoi(argv[++i]);
+        else if (hasValue && strcmp(argv[i], "-gc-time-limit") == 0)
+            gcConfiguration.m_incrementalTimeLimit = atoi(argv[++i]);
+        else if (hasValue && strcmp(argv[i], "-heap-profile") == 0)
+            heapProfilePath = argv[++i];
+        else if (hasValue && strcmp(argv[i], "-heap-profile-live") == 0)
+            liveHeapProfilePath = argv[++i];
+        else if (hasValue && strcmp(argv[i], "-heap-profile-interval") == 0)
+            heapProfileInterval = atoi(argv[++i]);
+    }
+    escargot::ESVMInstance::configureGC(gcConfiguration);
+
     escargot::ESVMInstance* ES = new escargot::ESVMInstance();
     ES->enter();
 
@@ -294,6 +397,10 @@ int main(int argc, char* argv[])
     else
         ES->setTimezoneID(icu::UnicodeString("Asia/Seoul"));
 
+    bool printGCStatistics = false;
+    bool isWorker = false;
+    if (heapProfilePath || liveHeapProfilePath)
+        escargot::HeapProfiler::start(heapProfileInterval);
     if (argc == 1) {
         while (true) {
             char buf[512];
@@ -349,9 +456,46 @@ int main(int argc, char* argv[])
             if (strcmp(argv[i], "-ot") == 0) {
                 ES->m_osrExitThreshold = atoi(argv[++i]);
             }
+            if (strcmp(argv[i], "-gc-markers") == 0 || strcmp(argv[i], "-gc-full-freq") == 0
+                || strcmp(argv[i], "-gc-free-space-divisor") == 0 || strcmp(argv[i], "-gc-time-limit") == 0
+                || strcmp(argv[i], "-heap-profile") == 0 || strcmp(argv[i], "-heap-profile-live") == 0
+                || strcmp(argv[i], "-heap-profile-interval") == 0) {
+                // read before the instance was created
+                i++;
+                continue;
+            }
+            if (strcmp(argv[i], "--gc-stats") == 0) {
+                printGCStatistics = true;
+                continue;
+            }
+            if (strcmp(argv[i], "-worker") == 0 && i + 1 < argc) {
+                // the next script runs in a process forked from the instance as the scripts before it left it
+                pid_t pid = ES->forkWorker();
+                if (pid < 0)
+                    return 3;
+                i++;
+                if (pid) {
+                    int status;
+                    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status))
+                        return 3;
+                    continue;
+                }
+                isWorker = true;
+            }
+            if (strcmp(argv[i], "-json") == 0 && i + 1 < argc) {
+                if (!parseJSONFile(ES, argv[++i]))
+                    return 3;
+                continue;
+            }
             if (strcmp(argv[i], "-p") == 0) {
                 ES->m_profile = true;
             }
+            if (strcmp(argv[i], "-regexp-interpreter") == 0) {
+                ES->m_useRegExpInterpreter = true;
+            }
+            if (strcmp(argv[i], "-regexp-verify") == 0) {
+                ES->m_verifyRegExpMatcher = true;
+            }
             FILE* fp = fopen(argv[i], "r");
             if (fp) {
                 escargot::ASCIIString str;
@@ -365,6 +509,8 @@ int main(int argc, char* argv[])
                 if (!evaluate(ES, source, false, true))
                     return 3;
             }
+            if (isWorker)
+                break;
 
             if (strcmp(argv[i], "--shell") == 0) {
                 while (true) {
@@ -381,6 +527,13 @@ int main(int argc, char* argv[])
             }
         }
     }
+    if (printGCStatistics)
+        escargot::ESVMInstance::dumpGCStatistics(stderr);
+    if (heapProfilePath || liveHeapProfilePath) {
+        escargot::HeapProfiler::stop();
+        dumpHeapProfile(heapProfilePath, escargot::HeapProfiler::AllocatedBytes);
+        dumpHeapProfile(liveHeapProfilePath, escargot::HeapProfiler::LiveBytes);
+    }
 #ifdef ESCARGOT_PROFILE
     dumpStats();
 #endif
@@ -22,6 +22,7 @@
 #include "runtime/ExecutionContext.h"
 #include "runtime/GlobalObject.h"
 #include "runtime/JobQueue.h"
+#include "runtime/JSONParser.h"
 #include "bytecode/ByteCode.h"
 #ifdef ENABLE_ESJIT
 #include "nanojit.h"
@@ -29,10 +30,23 @@
 
 #include "BumpPointerAllocator.h"
 
+#include <mutex>
+
 namespace escargot {
 
 
-size_t ESVMInstance::m_nativeHeapUsage = 0;
+GCPauseStatistics ESVMInstance::m_gcPauseStatistics;
+uint64_t ESVMInstance::m_gcPauseStartTime = 0;
+bool ESVMInstance::m_gcPauseStarted = false;
+bool ESVMInstance::m_inFullCollection = false;
+size_t ESVMInstance::m_heapSizeAtLastGC = 0;
+ssize_t ESVMInstance::m_heapGrowth = 0;
+size_t ESVMInstance::m_peakHeapSize = 0;
+
+// the instances that set a collector heap hard limit, with their limit; never dereferenced
+static std::vector<std::pair<ESVMInstance*, size_t> > gcHeapHardLimits;
+static std::mutex gcHeapHardLimitsMutex;
+static size_t appliedGCHeapHardLimit = 0;
 
 #ifndef ANDROID
 __thread ESVMInstance* currentInstance;
@@ -42,11 +56,31 @@ ESVMInstance* currentInstance;
 
 ESVMInstance::ESVMInstance()
 {
+    m_atomicStringMapSweptGCCount = GC_get_gc_no();
+    m_atomicStringMapSweptEntryCount = 0;
+    memset(m_numberToStringCache, 0, sizeof(m_numberToStringCache));
+    m_numberToStringCacheHitCount = 0;
+    m_numberToStringCacheMissCount = 0;
+    m_regexpCacheBytes = 0;
+    m_regexpCacheCompileCount = 0;
+    m_regexpCacheHitCount = 0;
+    m_regexpCacheEvictedCount = 0;
+    m_nativeHeapUsage = 0;
+    m_gcHeapBytesAllocated = 0;
+    m_gcTotalBytesAtEnter = 0;
+    updateNativeHeapCheckThreshold();
+
     GC_set_oom_fn([](size_t bytes) -> void* {
         ESVMInstanceCurrentInstance()->throwOOMError();
         RELEASE_ASSERT_NOT_REACHED();
     });
 
+    GC_set_on_collection_event(onGCEvent);
+
+    // no-order finalizers (CodeBlock, ArrayBuffer) release what their object points to,
+    // so the collector must keep that alive until they have run, whatever its build default is
+    GC_set_java_finalization(1);
+
     /*
     GC_set_on_collection_event([](GC_EventType evtType) {
         if (evtType == GC_EVENT_END) {
@@ -65,6 +99,8 @@ ESVMInstance::ESVMInstance()
     m_useCseFilter = false;
     m_jitThreshold = 2;
     m_osrExitThreshold = 1;
+    m_useRegExpInterpreter = false;
+    m_verifyRegExpMatcher = false;
     enter();
 
     m_scriptParser = new(GC) ScriptParser();
@@ -222,6 +258,241 @@ ESVMInstance::~ESVMInstance()
 #ifdef ENABLE_ESJIT
     delete m_JITConfig;
 #endif
+    for (auto iter = m_atomicStringMap.begin(); iter != m_atomicStringMap.end(); iter ++) {
+        if (iter->second.m_string)
+            GC_unregister_disappearing_link((void **)&iter->second.m_string);
+        if (iter->second.m_ownsKey)
+            free((void *)iter->first.m_data);
+    }
+    if (m_memoryLimits.m_gcHeapHardLimit)
+        setGCHeapHardLimit(0);
+}
+
+void ESVMInstance::configureGC(const GCConfiguration& configuration)
+{
+    if (configuration.m_markerThreadCount) {
+        // read by the collector when it starts
+        char count[16];
+        snprintf(count, sizeof(count), "%u", configuration.m_markerThreadCount);
+        setenv("GC_MARKERS", count, 1);
+    }
+    if (configuration.m_freeSpaceDivisor)
+        GC_set_free_space_divisor(configuration.m_freeSpaceDivisor);
+    if (configuration.m_fullCollectionFrequency)
+        GC_set_full_freq(configuration.m_fullCollectionFrequency);
+    if (configuration.m_incrementalTimeLimit)
+        GC_set_time_limit(configuration.m_incrementalTimeLimit);
+    if (configuration.m_incremental)
+        GC_enable_incremental();
+}
+
+pid_t ESVMInstance::forkWorker()
+{
+    // collect the garbage of the warm-up once here, not once in every worker
+    if (GC_get_bytes_since_gc())
+        GC_gcollect();
+    // or both processes would write what is buffered
+    fflush(NULL);
+
+    // no-ops when the collector installed its own fork handlers
+    GC_atfork_prepare();
+    pid_t pid = fork();
+    if (pid == 0)
+        GC_atfork_child();
+    else
+        GC_atfork_parent();
+    return pid;
+}
+
+static uint64_t gcEventTime()
+{
+    struct timespec timespec;
+    clock_gettime(CLOCK_MONOTONIC, &timespec);
+    return (uint64_t)timespec.tv_sec * 1000000 + timespec.tv_nsec / 1000;
+}
+
+void ESVMInstance::beginGCPause()
+{
+    if (m_gcPauseStarted)
+        return;
+    m_gcPauseStarted = true;
+    m_gcPauseStartTime = gcEventTime();
+}
+
+void ESVMInstance::endGCPause()
+{
+    if (!m_gcPauseStarted)
+        return;
+    m_gcPauseStarted = false;
+    uint64_t pause = gcEventTime() - m_gcPauseStartTime;
+    m_gcPauseStatistics.m_pauseCount++;
+    m_gcPauseStatistics.m_totalPauseTime += pause;
+    m_gcPauseStatistics.m_maxPauseTime = std::max(m_gcPauseStatistics.m_maxPauseTime, pause);
+    m_gcPauseStatistics.m_lastPauseTime = pause;
+
+    size_t bucket = 0;
+    for (uint64_t limit = 1000; bucket < GCPauseStatistics::HistogramBucketCount - 1 && pause >= limit; limit *= 2)
+        bucket++;
+    m_gcPauseStatistics.m_histogram[bucket]++;
+}
+
+// The mutator waits for a whole full collection, sweeping included, but only for the
+// world-stopped part of an incremental step
+void ESVMInstance::onGCEvent(GC_EventType type)
+{
+    switch (type) {
+    case GC_EVENT_START:
+        m_inFullCollection = true;
+        beginGCPause();
+        break;
+    case GC_EVENT_END: {
+        m_inFullCollection = false;
+        endGCPause();
+        size_t heapSize = GC_get_heap_size();
+        m_heapGrowth = (ssize_t)heapSize - (ssize_t)m_heapSizeAtLastGC;
+        m_heapSizeAtLastGC = heapSize;
+        m_peakHeapSize = std::max(m_peakHeapSize, heapSize);
+        if (ESVMInstance* instance = currentInstance())
+            instance->checkGCHeapSoftLimit(heapSize - GC_get_free_bytes());
+        break;
+    }
+    case GC_EVENT_PRE_STOP_WORLD:
+        beginGCPause();
+        break;
+    case GC_EVENT_POST_START_WORLD:
+        if (!m_inFullCollection)
+            endGCPause();
+        break;
+    default:
+        break;
+    }
+}
+
+size_t ESVMInstance::gcHeapBytesAllocated()
+{
+    if (currentInstance() == this)
+        return m_gcHeapBytesAllocated + GC_get_total_bytes() - m_gcTotalBytesAtEnter;
+    return m_gcHeapBytesAllocated;
+}
+
+void ESVMInstance::setMemoryLimits(const MemoryLimits& limits)
+{
+    if (limits.m_gcHeapHardLimit || m_memoryLimits.m_gcHeapHardLimit)
+        setGCHeapHardLimit(limits.m_gcHeapHardLimit);
+    m_memoryLimits = limits;
+    updateNativeHeapCheckThreshold();
+}
+
+void ESVMInstance::setGCHeapHardLimit(size_t limit)
+{
+    std::lock_guard<std::mutex> guard(gcHeapHardLimitsMutex);
+    gcHeapHardLimits.erase(std::remove_if(gcHeapHardLimits.begin(), gcHeapHardLimits.end(), [this](const std::pair<ESVMInstance*, size_t>& entry) {
+        return entry.first == this;
+    }), gcHeapHardLimits.end());
+    if (limit)
+        gcHeapHardLimits.push_back(std::make_pair(this, limit));
+
+    // the heap is shared, so the tightest limit holds for everyone
+    size_t applied = 0;
+    for (auto& entry : gcHeapHardLimits) {
+        if (!applied || entry.second < applied)
+            applied = entry.second;
+    }
+    // 0 lifts the cap once no live instance has a limit
+    if (applied != appliedGCHeapHardLimit) {
+        GC_set_max_heap_size(applied);
+        appliedGCHeapHardLimit = applied;
+    }
+}
+
+size_t ESVMInstance::gcHeapHardLimit()
+{
+    std::lock_guard<std::mutex> guard(gcHeapHardLimitsMutex);
+    return appliedGCHeapHardLimit;
+}
+
+void ESVMInstance::updateNativeHeapCheckThreshold()
+{
+    size_t softLimit = m_memoryLimits.m_nativeHeapSoftLimit;
+    size_t hardLimit = m_memoryLimits.m_nativeHeapHardLimit;
+    size_t usage = nativeHeapUsage();
+    if (usage <= softLimit)
+        m_nativeHeapCheckThreshold = std::min(softLimit, hardLimit);
+    else
+        m_nativeHeapCheckThreshold = std::min(hardLimit, usage + usage / 4);
+}
+
+void ESVMInstance::nativeHeapLimitExceeded()
+{
+    // finalizers of dead objects may give native memory back
+    if (nativeHeapUsage() > m_memoryLimits.m_nativeHeapHardLimit) {
+        GC_gcollect();
+        if (nativeHeapUsage() > m_memoryLimits.m_nativeHeapHardLimit)
+            throwOOMError();
+    } else if (m_memoryLimits.m_pressureCallback) {
+        m_memoryLimits.m_pressureCallback(this, NativeHeapSoftLimitExceeded, nativeHeapUsage(), m_memoryLimits.m_pressureCallbackData);
+    } else {
+        GC_gcollect();
+    }
+    updateNativeHeapCheckThreshold();
+}
+
+void ESVMInstance::checkGCHeapSoftLimit(size_t usage)
+{
+    if (usage > m_memoryLimits.m_gcHeapSoftLimit && m_memoryLimits.m_pressureCallback)
+        m_memoryLimits.m_pressureCallback(this, GCHeapSoftLimitExceeded, usage, m_memoryLimits.m_pressureCallbackData);
+}
+
+GCStatistics ESVMInstance::gcStatistics()
+{
+    GCStatistics statistics;
+    statistics.m_collectionCount = GC_get_gc_no();
+    statistics.m_heapSize = GC_get_heap_size();
+    statistics.m_peakHeapSize = std::max(m_peakHeapSize, statistics.m_heapSize);
+    statistics.m_freeBytes = GC_get_free_bytes();
+    statistics.m_bytesAllocatedSinceGC = GC_get_bytes_since_gc();
+    statistics.m_totalBytesAllocated = GC_get_total_bytes();
+    statistics.m_heapGrowth = m_heapGrowth;
+    statistics.m_pauses = m_gcPauseStatistics;
+    return statistics;
+}
+
+void ESVMInstance::dumpGCStatistics(FILE* stream)
+{
+    GCStatistics statistics = gcStatistics();
+    fprintf(stream, "{\n");
+    fprintf(stream, "  \"collections\": %zu,\n", statistics.m_collectionCount);
+    fprintf(stream, "  \"heapSize\": %zu,\n", statistics.m_heapSize);
+    fprintf(stream, "  \"peakHeapSize\": %zu,\n", statistics.m_peakHeapSize);
+    fprintf(stream, "  \"freeBytes\": %zu,\n", statistics.m_freeBytes);
+    fprintf(stream, "  \"bytesAllocatedSinceGC\": %zu,\n", statistics.m_bytesAllocatedSinceGC);
+    fprintf(stream, "  \"totalBytesAllocated\": %zu,\n", statistics.m_totalBytesAllocated);
+    fprintf(stream, "  \"heapGrowth\": %zd,\n", statistics.m_heapGrowth);
+
+    const GCPauseStatistics& pauses = statistics.m_pauses;
+    fprintf(stream, "  \"pauses\": {\n");
+    fprintf(stream, "    \"count\": %zu,\n", pauses.m_pauseCount);
+    fprintf(stream, "    \"totalUs\": %llu,\n", (unsigned long long)pauses.m_totalPauseTime);
+    fprintf(stream, "    \"maxUs\": %llu,\n", (unsigned long long)pauses.m_maxPauseTime);
+    fprintf(stream, "    \"lastUs\": %llu,\n", (unsigned long long)pauses.m_lastPauseTime);
+    fprintf(stream, "    \"histogram\": [");
+    for (size_t i = 0; i < GCPauseStatistics::HistogramBucketCount; i++) {
+        if (i < GCPauseStatistics::HistogramBucketCount - 1)
+            fprintf(stream, "%s{ \"underMs\": %u, \"count\": %zu }", i ? ", " : "", 1u << i, pauses.m_histogram[i]);
+        else
+            fprintf(stream, ", { \"overMs\": %u, \"count\": %zu }", 1u << (i - 1), pauses.m_histogram[i]);
+    }
+    fprintf(stream, "]\n");
+    fprintf(stream, "  },\n");
+
+    fprintf(stream, "  \"allocations\": {\n");
+    for (size_t i = 0; i < ESPointer::TotalNumberOfTypes; i++) {
+        if (ESPointer::m_allocationCount[i])
+            fprintf(stream, "    \"%s\": %zu,\n", ESPointer::typeName(i), ESPointer::m_allocationCount[i]);
+    }
+    fprintf(stream, "    \"CodeBlock\": %zu\n", CodeBlock::m_allocationCount);
+    fprintf(stream, "  }\n");
+    fprintf(stream, "}\n");
 }
 
 ESValue ESVMInstance::evaluate(ESString* source)
@@ -250,6 +521,11 @@ ESValue ESVMInstance::evaluate(ESString* source)
     return m_lastExpressionStatementValue;
 }
 
+JSONStreamParser ESVMInstance::createJSONStreamParser()
+{
+    return JSONStreamParser(this);
+}
+
 ESValue ESVMInstance::evaluateEval(ESString* source, bool isDirectCall, CodeBlock* outerCodeBlock)
 {
     ExecutionContext* oldContext = m_currentExecutionContext;
@@ -292,6 +568,7 @@ ESValue ESVMInstance::evaluateEval(ESString* source, bool isDirectCall, CodeBloc
 
 void ESVMInstance::exit()
 {
+    m_gcHeapBytesAllocated += GC_get_total_bytes() - m_gcTotalBytesAtEnter;
     escargot::currentInstance = NULL;
     escargot::strings = NULL;
 }
@@ -41,6 +41,7 @@ class Try;
 class ScriptParser;
 class ESIdentifierVector;
 class JobQueue;
+class JSONStreamParser;
 struct ESSimpleAllocatorMemoryFragment;
 
 #ifndef ANDROID
@@ -49,9 +50,135 @@ extern __thread ESVMInstance* currentInstance;
 extern ESVMInstance* currentInstance;
 #endif
 
-typedef std::unordered_map<std::pair<const char *, size_t>, ESString *,
-    std::hash<std::pair<const char *, size_t> >, std::equal_to<std::pair<const char *, size_t> >,
-    gc_allocator<std::pair<const std::pair<const char *, size_t>, ESString *> > > InternalAtomicStringMap;
+// The atomic string table holds its strings weakly.
+// Nodes live in malloc memory (not scanned by GC) and every m_string slot is registered as a disappearing link,
+// so a string only reachable from this table gets collected and its slot is cleared.
+// Cleared entries are swept lazily, once per GC cycle, before the table is touched again (see InternalAtomicString.cpp).
+// Static strings are pinned by Strings.
+struct InternalAtomicStringMapEntry {
+    ESString* m_string;
+    // the key is a malloc'd UTF-8 copy owned by this entry (non-ASCII strings)
+    // otherwise it points into m_string's own buffer
+    bool m_ownsKey;
+};
+
+typedef std::unordered_map<InternalAtomicStringKey, InternalAtomicStringMapEntry,
+    std::hash<InternalAtomicStringKey>, std::equal_to<InternalAtomicStringKey> > InternalAtomicStringMap;
+
+struct InternalAtomicStringMapStatistics {
+    size_t m_entryCount;
+    size_t m_bucketCount;
+    // buckets holding more than one entry
+    size_t m_collidedBucketCount;
+    size_t m_longestChainLength;
+    // entries removed so far because their string was collected
+    size_t m_sweptEntryCount;
+};
+
+struct NumberToStringCacheEntry {
+    double m_number;
+    ESString* m_string;
+};
+
+struct NumberToStringCacheStatistics {
+    size_t m_hitCount;
+    size_t m_missCount;
+};
+
+struct RegExpCacheStatistics {
+    size_t m_entryCount;
+    // approximate size of the compiled patterns held by the cache
+    size_t m_bytes;
+    size_t m_compileCount;
+    size_t m_hitCount;
+    size_t m_evictedCount;
+};
+
+// Collector settings for a deployment. Zero keeps the collector's default.
+struct GCConfiguration {
+    GCConfiguration()
+        : m_markerThreadCount(0)
+        , m_incremental(false)
+        , m_fullCollectionFrequency(0)
+        , m_freeSpaceDivisor(0)
+        , m_incrementalTimeLimit(0)
+    {
+    }
+
+    // only read when the collector starts; needs a collector built with --enable-parallel-mark
+    unsigned m_markerThreadCount;
+    // incremental, generational collection using page protection to find modified objects
+    bool m_incremental;
+    // in incremental mode, one full collection every this many collections
+    int m_fullCollectionFrequency;
+    // the heap grows instead of collecting when less than 1/divisor of it could be freed;
+    // larger values give a smaller heap and more collections
+    size_t m_freeSpaceDivisor;
+    // the pause budget of an incremental step, in milliseconds
+    unsigned long m_incrementalTimeLimit;
+};
+
+// times in microseconds. A pause is a whole collection, or an incremental step that stops the world
+struct GCPauseStatistics {
+    // bucket 0 counts pauses under 1ms, bucket i pauses under 2^i ms, the last one everything longer
+    static const size_t HistogramBucketCount = 12;
+
+    size_t m_pauseCount;
+    uint64_t m_totalPauseTime;
+    uint64_t m_maxPauseTime;
+    uint64_t m_lastPauseTime;
+    size_t m_histogram[HistogramBucketCount];
+};
+
+// sizes in bytes
+struct GCStatistics {
+    size_t m_collectionCount;
+    size_t m_heapSize;
+    size_t m_peakHeapSize;
+    size_t m_freeBytes;
+    size_t m_bytesAllocatedSinceGC;
+    size_t m_totalBytesAllocated;
+    // heap size change between the last two collections
+    ssize_t m_heapGrowth;
+    GCPauseStatistics m_pauses;
+};
+
+enum MemoryPressureKind {
+    NativeHeapSoftLimitExceeded,
+    GCHeapSoftLimitExceeded,
+};
+
+// Runs on the allocation that crossed a native soft limit, or inside the collector for
+// the collector heap: it must not allocate collected memory or run script.
+typedef void (*MemoryPressureCallback)(ESVMInstance* instance, MemoryPressureKind kind, size_t usage, void* data);
+
+// Memory budgets in bytes; SIZE_MAX, or 0 for m_gcHeapHardLimit, is no limit.
+// Native bytes are counted per instance. The collector heap is shared by every instance
+// in the process, so its limits apply to the whole heap, and of the hard limits set by
+// live instances the smallest is the one in force.
+struct MemoryLimits {
+    MemoryLimits()
+        : m_nativeHeapSoftLimit(SIZE_MAX)
+        , m_nativeHeapHardLimit(options::NativeHeapUsageThreshold)
+        , m_gcHeapSoftLimit(SIZE_MAX)
+        , m_gcHeapHardLimit(0)
+        , m_pressureCallback(NULL)
+        , m_pressureCallbackData(NULL)
+    {
+    }
+
+    // past it the callback runs, or a collection is made when there is none;
+    // reported again after each further 25% of growth
+    size_t m_nativeHeapSoftLimit;
+    // past it, and still past it after a collection, the allocation throws a RangeError
+    size_t m_nativeHeapHardLimit;
+    // compared with the bytes not known to be free after each collection
+    size_t m_gcHeapSoftLimit;
+    // the collector heap does not grow beyond it; the allocation that needs more throws a RangeError
+    size_t m_gcHeapHardLimit;
+    MemoryPressureCallback m_pressureCallback;
+    void* m_pressureCallbackData;
+};
 
 class ESVMInstance : public gc {
 #ifdef ENABLE_ESJIT
@@ -85,6 +212,7 @@ public:
         escargot::strings = &m_strings;
         char dummy;
         m_stackStart = &dummy;
+        m_gcTotalBytesAtEnter = GC_get_total_bytes();
     }
 
     void exit();
@@ -158,9 +286,37 @@ public:
         return m_scriptParser;
     }
 
-    ALWAYS_INLINE std::unordered_map<double, ESString*, std::hash<double>, std::equal_to<double>, gc_allocator<std::pair<const double, ESString* > > >* dtoaCache()
+    // direct-mapped cache of recent number to string conversions.
+    // integers index it directly, so a run of consecutive ones never collides
+    ALWAYS_INLINE NumberToStringCacheEntry& numberToStringCacheEntry(int32_t number)
     {
-        return &m_dtoaCache;
+        return m_numberToStringCache[(uint32_t)number & (options::NumberToStringCacheSize - 1)];
+    }
+
+    // for doubles that are not int32
+    ALWAYS_INLINE NumberToStringCacheEntry& numberToStringCacheEntry(double number)
+    {
+        uint64_t bits;
+        memcpy(&bits, &number, sizeof(double));
+        uint32_t hash = (uint32_t)(bits ^ (bits >> 32));
+        hash ^= hash >> 16;
+        return m_numberToStringCache[hash & (options::NumberToStringCacheSize - 1)];
+    }
+
+    ALWAYS_INLINE void countNumberToStringCacheHit(bool hit)
+    {
+        if (hit)
+            m_numberToStringCacheHitCount++;
+        else
+            m_numberToStringCacheMissCount++;
+    }
+
+    NumberToStringCacheStatistics numberToStringCacheStatistics()
+    {
+        NumberToStringCacheStatistics stat;
+        stat.m_hitCount = m_numberToStringCacheHitCount;
+        stat.m_missCount = m_numberToStringCacheMissCount;
+        return stat;
     }
 
     ALWAYS_INLINE std::unordered_map<ESRegExpObject::RegExpCacheKey, ESRegExpObject::RegExpCacheEntry,
@@ -170,6 +326,37 @@ public:
         return &m_regexpCache;
     }
 
+    // called for every lookup; the entry becomes the most recently used one
+    void touchRegExpCacheEntry(ESRegExpObject::RegExpCacheEntry& entry)
+    {
+        m_regexpCacheLRU.splice(m_regexpCacheLRU.begin(), m_regexpCacheLRU, entry.m_lruPosition);
+    }
+
+    // evicts least recently used entries until the cache fits options::RegExpCacheSizeThreshold.
+    // The most recently used entry is always kept; evicted patterns stay alive as long as
+    // some ESRegExpObject still refers to them, and are finalized by the GC afterwards
+    void addRegExpCacheBytes(ESRegExpObject::RegExpCacheEntry& entry, size_t bytes);
+    RegExpCacheStatistics regexpCacheStatistics();
+
+    InternalAtomicStringMapStatistics atomicStringMapStatistics();
+
+    // call before the first ESVMInstance is created; the marker thread count is ignored afterwards
+    static void configureGC(const GCConfiguration& configuration);
+    static GCPauseStatistics gcPauseStatistics() { return m_gcPauseStatistics; }
+    static GCStatistics gcStatistics();
+    // collector state, pauses and allocation counts by ESPointer::Type as one JSON object
+    static void dumpGCStatistics(FILE* stream);
+
+    // JSON.parse for UTF-8 text that arrives in chunks (see JSONParser.h)
+    JSONStreamParser createJSONStreamParser();
+
+    // Starts a short-lived worker from this instance as a startup snapshot.
+    // The worker is a forked process: the initialized (and possibly warmed up) heap,
+    // strings, hidden classes and CodeBlocks are shared copy-on-write, and need no
+    // fixups since every object keeps its address. Call it between scripts, with the
+    // job queue drained. Returns like fork(): 0 in the worker, its pid in the caller.
+    pid_t forkWorker();
+
     // Function for debug
     static void printValue(ESValue val, bool newLine = true);
     ALWAYS_INLINE unsigned long tickCount()
@@ -306,22 +493,30 @@ public:
 
     void nativeHeapAllocated(size_t size, void* ptr)
     {
-        m_nativeHeapUsage += size;
+        size_t usage = m_nativeHeapUsage.fetch_add(size, std::memory_order_relaxed) + size;
 
         (void)ptr;
-        // printf("allocate %zu (current %zu) %p\n", size, m_nativeHeapUsage, ptr);
+        // printf("allocate %zu (current %zu) %p\n", size, usage, ptr);
 
-        if (m_nativeHeapUsage > options::NativeHeapUsageThreshold)
-            throwOOMError();
+        if (UNLIKELY(usage > m_nativeHeapCheckThreshold))
+            nativeHeapLimitExceeded();
     }
+    // may be called from another thread, by a finalizer of memory this instance counted
     void nativeHeapDeallocated(size_t size, void* ptr)
     {
-        m_nativeHeapUsage -= size;
+        m_nativeHeapUsage.fetch_sub(size, std::memory_order_relaxed);
 
         (void)ptr;
-        // printf("deallocate %zu (current %zu) %p\n", size, m_nativeHeapUsage, ptr);
+        // printf("deallocate %zu %p\n", size, ptr);
     }
-    size_t nativeHeapUsage() { return m_nativeHeapUsage; }
+    size_t nativeHeapUsage() { return m_nativeHeapUsage.load(std::memory_order_relaxed); }
+    // collected bytes allocated while this instance was entered
+    size_t gcHeapBytesAllocated();
+
+    void setMemoryLimits(const MemoryLimits& limits);
+    const MemoryLimits& memoryLimits() { return m_memoryLimits; }
+    // the collector heap hard limit in force for the process, or 0 for none
+    static size_t gcHeapHardLimit();
 
     icu::Locale& locale()
     {
@@ -377,6 +572,10 @@ public:
     size_t m_jitThreshold;
     size_t m_osrExitThreshold;
     bool m_profile;
+    // run every regexp on the Yarr interpreter instead of RegExpMatcher
+    bool m_useRegExpInterpreter;
+    // run the interpreter after every RegExpMatcher match and abort if the results differ
+    bool m_verifyRegExpMatcher;
 
 protected:
     ScriptParser* m_scriptParser;
@@ -395,7 +594,17 @@ protected:
 
     friend class InternalAtomicString;
     friend class InternalAtomicStringData;
+    friend class ESRegExpObject;
+    ALWAYS_INLINE void sweepAtomicStringMapIfNeeded()
+    {
+        if (UNLIKELY(m_atomicStringMapSweptGCCount != GC_get_gc_no()))
+            sweepAtomicStringMap();
+    }
+    void sweepAtomicStringMap();
+    void insertAtomicString(const char* key, size_t keyLength, ESString* string, bool ownsKey);
     InternalAtomicStringMap m_atomicStringMap;
+    GC_word m_atomicStringMapSweptGCCount;
+    size_t m_atomicStringMapSweptEntryCount;
 
     Strings m_strings;
     unsigned m_identifierCacheInvalidationCheckCount;
@@ -429,17 +638,44 @@ protected:
     ESValue m_error;
 
     std::vector<ESSimpleAllocatorMemoryFragment, pointer_free_allocator<ESSimpleAllocatorMemoryFragment> > m_allocatedMemorys;
-    static size_t m_nativeHeapUsage;
+    NEVER_INLINE void nativeHeapLimitExceeded();
+    void updateNativeHeapCheckThreshold();
+    void setGCHeapHardLimit(size_t limit);
+    void checkGCHeapSoftLimit(size_t usage);
+    std::atomic<size_t> m_nativeHeapUsage;
+    // the smaller of the limits not yet reported
+    size_t m_nativeHeapCheckThreshold;
+    size_t m_gcHeapBytesAllocated;
+    size_t m_gcTotalBytesAtEnter;
+    MemoryLimits m_memoryLimits;
+
+    static void onGCEvent(GC_EventType type);
+    static void beginGCPause();
+    static void endGCPause();
+    static GCPauseStatistics m_gcPauseStatistics;
+    static uint64_t m_gcPauseStartTime;
+    static bool m_gcPauseStarted;
+    static bool m_inFullCollection;
+    static size_t m_heapSizeAtLastGC;
+    static ssize_t m_heapGrowth;
+    static size_t m_peakHeapSize;
 
 #ifdef ENABLE_ESJIT
     nanojit::Config* m_JITConfig;
 #endif
 
-    std::unordered_map<double, ESString*, std::hash<double>, std::equal_to<double>, gc_allocator<std::pair<const double, ESString* > > > m_dtoaCache;
+    NumberToStringCacheEntry m_numberToStringCache[options::NumberToStringCacheSize];
+    size_t m_numberToStringCacheHitCount;
+    size_t m_numberToStringCacheMissCount;
 
     std::unordered_map<ESRegExpObject::RegExpCacheKey, ESRegExpObject::RegExpCacheEntry,
         std::hash<ESRegExpObject::RegExpCacheKey>, std::equal_to<ESRegExpObject::RegExpCacheKey>,
         gc_allocator<std::pair<ESRegExpObject::RegExpCacheKey, ESRegExpObject::RegExpCacheEntry> > > m_regexpCache;
+    ESRegExpObject::RegExpCacheLRUList m_regexpCacheLRU;
+    size_t m_regexpCacheBytes;
+    size_t m_regexpCacheCompileCount;
+    size_t m_regexpCacheHitCount;
+    size_t m_regexpCacheEvictedCount;
 
     std::unordered_set<ESObject*, std::hash<ESObject*>, std::equal_to<ESObject*>, gc_allocator<ESObject*> > m_checkedObjects;
     std::unordered_set<ESString*, std::hash<ESString*>, std::equal_to<ESString*>, gc_allocator<ESString*> > m_outerFENames;
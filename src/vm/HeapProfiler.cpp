@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "Escargot.h"
+#include "HeapProfiler.h"
+#include "vm/ESVMInstance.h"
+#include "runtime/ExecutionContext.h"
+
+#include <deque>
+
+namespace escargot {
+
+bool HeapProfiler::s_isSampling = false;
+
+namespace {
+
+struct Sample {
+    // a disappearing link: the collector clears it when the object dies
+    void* m_object;
+    size_t m_stackIndex;
+    size_t m_bytes;
+};
+
+// Lives in the malloc heap, which the collector does not scan, so the sampled
+// objects are not kept alive by the profiler
+struct HeapProfile {
+    HeapProfile(size_t samplingInterval)
+        : m_samplingInterval(samplingInterval)
+        , m_nextSampleTotalBytes(GC_get_total_bytes() + samplingInterval)
+        , m_lastSampleTotalBytes(GC_get_total_bytes())
+    {
+    }
+
+    ~HeapProfile()
+    {
+        for (Sample& sample : m_samples) {
+            if (sample.m_object)
+                GC_unregister_disappearing_link(&sample.m_object);
+        }
+    }
+
+    size_t m_samplingInterval;
+    size_t m_nextSampleTotalBytes;
+    size_t m_lastSampleTotalBytes;
+    std::vector<std::string> m_stacks;
+    std::unordered_map<std::string, size_t> m_stackIndexes;
+    // links are registered by address, so samples must not move
+    std::deque<Sample> m_samples;
+};
+
+HeapProfile* profile;
+
+}
+
+void HeapProfiler::start(size_t samplingInterval)
+{
+    delete profile;
+    profile = new HeapProfile(samplingInterval);
+    s_isSampling = true;
+}
+
+void HeapProfiler::stop()
+{
+    s_isSampling = false;
+}
+
+static void appendFrameName(std::string& stack, ExecutionContext* ec)
+{
+    if (!ec->callerContext()) {
+        stack += "(global)";
+        return;
+    }
+    ESValue callee = ec->resolveCallee();
+    if (callee.isESPointer() && callee.asESPointer()->isESFunctionObject()) {
+        ESValue name = callee.asESPointer()->asESFunctionObject()->ownDataPropertyValue(strings->name.string());
+        if (!name.isEmpty() && name.isESString() && name.asESString()->length()) {
+            // ';' and ' ' are separators in the folded format
+            for (const char* c = name.asESString()->utf8Data(); *c; c++)
+                stack += (*c == ';' || *c == ' ') ? '_' : *c;
+            return;
+        }
+    }
+    stack += "(anonymous)";
+}
+
+void HeapProfiler::takeSampleIfNeeded(ESPointer* object)
+{
+    size_t totalBytes = GC_get_total_bytes();
+    if (totalBytes < profile->m_nextSampleTotalBytes)
+        return;
+    void* base = GC_base(object);
+    ESVMInstance* instance = ESVMInstance::currentInstance();
+    if (!base || !instance || !instance->currentExecutionContext())
+        return;
+
+    // naming the frames may allocate
+    s_isSampling = false;
+
+    std::vector<ExecutionContext*> contexts;
+    for (ExecutionContext* ec = instance->currentExecutionContext(); ec; ec = ec->callerContext())
+        contexts.push_back(ec);
+    std::string stack;
+    for (size_t i = contexts.size(); i > 0; i--) {
+        if (i != contexts.size())
+            stack += ';';
+        appendFrameName(stack, contexts[i - 1]);
+    }
+
+    auto iter = profile->m_stackIndexes.find(stack);
+    size_t stackIndex;
+    if (iter == profile->m_stackIndexes.end()) {
+        stackIndex = profile->m_stacks.size();
+        profile->m_stackIndexes.insert(std::make_pair(stack, stackIndex));
+        profile->m_stacks.push_back(std::move(stack));
+    } else {
+        stackIndex = iter->second;
+    }
+
+    profile->m_samples.push_back(Sample { base, stackIndex, totalBytes - profile->m_lastSampleTotalBytes });
+    GC_general_register_disappearing_link(&profile->m_samples.back().m_object, base);
+    profile->m_lastSampleTotalBytes = totalBytes;
+    profile->m_nextSampleTotalBytes = totalBytes + profile->m_samplingInterval;
+
+    s_isSampling = true;
+}
+
+void HeapProfiler::dumpFoldedStacks(FILE* stream, Metric metric)
+{
+    if (!profile)
+        return;
+    if (metric == LiveBytes)
+        GC_gcollect();
+
+    std::vector<size_t> bytes(profile->m_stacks.size());
+    for (const Sample& sample : profile->m_samples) {
+        if (metric == AllocatedBytes || sample.m_object)
+            bytes[sample.m_stackIndex] += sample.m_bytes;
+    }
+    for (size_t i = 0; i < bytes.size(); i++) {
+        if (bytes[i])
+            fprintf(stream, "%s %zu\n", profile->m_stacks[i].c_str(), bytes[i]);
+    }
+}
+
+}
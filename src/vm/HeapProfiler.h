@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2016 Samsung Electronics Co., Ltd
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *        http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#ifndef HeapProfiler_h
+#define HeapProfiler_h
+
+namespace escargot {
+
+class ESPointer;
+
+// Sampling allocation profiler.
+// Each time the collector has handed out another sampling interval of bytes, the next
+// ESPointer being constructed takes a sample: the interval is charged to the JS call stack
+// that is running, and the object is watched through a disappearing link to tell whether
+// it survives the collections that follow.
+// Profiles are written in the folded stack format of flamegraph.pl: "outer;inner bytes".
+class HeapProfiler {
+public:
+    enum Metric {
+        AllocatedBytes,
+        // bytes represented by the sampled objects that are still reachable
+        LiveBytes,
+    };
+
+    // drops the samples of an earlier run
+    static void start(size_t samplingInterval = 512 * 1024);
+    static void stop();
+    static bool isSampling() { return s_isSampling; }
+
+    static void allocated(ESPointer* object)
+    {
+        if (UNLIKELY(s_isSampling))
+            takeSampleIfNeeded(object);
+    }
+
+    // LiveBytes collects first, so only reachable objects are counted
+    static void dumpFoldedStacks(FILE* stream, Metric metric);
+
+private:
+    static void takeSampleIfNeeded(ESPointer* object);
+
+    static bool s_isSampling;
+};
+
+}
+
+#endif
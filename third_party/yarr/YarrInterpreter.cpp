@@ -1390,7 +1390,8 @@ public:
             if (backtrackParentheticalAssertionBegin(currentTerm(), context)) {
                 int end = context->term;
                 for (int i = start + 1; i < end; i++) {
-                    if (disjunction->terms[i].type == ByteTerm::ByteTerm::TypeParenthesesSubpatternOnceEnd) {
+                    // non-capturing groups have no output slots; their subpatternId may be past the end
+                    if (disjunction->terms[i].type == ByteTerm::ByteTerm::TypeParenthesesSubpatternOnceEnd && disjunction->terms[i].capture()) {
                         unsigned subpatternId = disjunction->terms[i].atom.subpatternId;
                         output[(subpatternId << 1)] = offsetNoMatch;
                         output[(subpatternId << 1) + 1] = offsetNoMatch;